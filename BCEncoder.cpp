@@ -0,0 +1,345 @@
+#include "BCEncoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+template< size_t N >
+using Vec = std::array< float, N >;
+
+template< size_t N >
+static float dot(Vec< N > const &a, Vec< N > const &b) {
+	float sum = 0.0f;
+	for (uint32_t c = 0; c < N; ++c) sum += a[c] * b[c];
+	return sum;
+}
+
+template< size_t N >
+static float distance2(Vec< N > const &a, Vec< N > const &b) {
+	float sum = 0.0f;
+	for (uint32_t c = 0; c < N; ++c) sum += (a[c] - b[c]) * (a[c] - b[c]);
+	return sum;
+}
+
+//a block's texels as floats:
+template< size_t N >
+static std::array< Vec< N >, 16 > to_texels(uint8_t const *data, uint32_t stride) {
+	std::array< Vec< N >, 16 > texels;
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t c = 0; c < N; ++c) texels[i][c] = float(data[i * stride + c]);
+	}
+	return texels;
+}
+
+//initial endpoints: the extent of the texels along their principal axis (found by power iteration on the covariance):
+template< size_t N >
+static void principal_endpoints(std::array< Vec< N >, 16 > const &texels, Vec< N > *low, Vec< N > *high) {
+	Vec< N > mean{};
+	for (Vec< N > const &t : texels) {
+		for (uint32_t c = 0; c < N; ++c) mean[c] += t[c] / 16.0f;
+	}
+
+	std::array< Vec< N >, N > covariance{};
+	for (Vec< N > const &t : texels) {
+		for (uint32_t r = 0; r < N; ++r) {
+			for (uint32_t c = 0; c < N; ++c) covariance[r][c] += (t[r] - mean[r]) * (t[c] - mean[c]);
+		}
+	}
+
+	Vec< N > axis;
+	axis.fill(1.0f);
+	for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+		Vec< N > next{};
+		for (uint32_t r = 0; r < N; ++r) next[r] = dot(covariance[r], axis);
+		float length = std::sqrt(dot(next, next));
+		if (length < 1e-6f) break; //(flat block; any axis will do)
+		for (uint32_t c = 0; c < N; ++c) axis[c] = next[c] / length;
+	}
+	float length = std::sqrt(dot(axis, axis));
+	for (uint32_t c = 0; c < N; ++c) axis[c] /= length;
+
+	float lo = 0.0f, hi = 0.0f;
+	for (Vec< N > const &t : texels) {
+		Vec< N > offset;
+		for (uint32_t c = 0; c < N; ++c) offset[c] = t[c] - mean[c];
+		float along = dot(offset, axis);
+		lo = std::min(lo, along);
+		hi = std::max(hi, along);
+	}
+	for (uint32_t c = 0; c < N; ++c) {
+		(*low)[c] = std::clamp(mean[c] + lo * axis[c], 0.0f, 255.0f);
+		(*high)[c] = std::clamp(mean[c] + hi * axis[c], 0.0f, 255.0f);
+	}
+}
+
+//endpoints minimizing squared error for fixed interpolation weights (texel i is (1 - weights[i]) * e0 + weights[i] * e1);
+// returns false if the system is degenerate (e.g., every texel uses the same weight):
+template< size_t N >
+static bool least_squares_endpoints(std::array< Vec< N >, 16 > const &texels, std::array< float, 16 > const &weights, Vec< N > *e0, Vec< N > *e1) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	Vec< N > ax{}, bx{};
+	for (uint32_t i = 0; i < 16; ++i) {
+		float b = weights[i], a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < N; ++c) {
+			ax[c] += a * texels[i][c];
+			bx[c] += b * texels[i][c];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f) return false;
+	for (uint32_t c = 0; c < N; ++c) {
+		(*e0)[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+		(*e1)[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+//picks the nearest palette entry for each texel; returns the total squared error:
+template< size_t N, size_t P >
+static float choose_indices(std::array< Vec< N >, 16 > const &texels, std::array< Vec< N >, P > const &palette, std::array< uint8_t, 16 > *indices) {
+	float total = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i) {
+		float best = distance2(texels[i], palette[0]);
+		(*indices)[i] = 0;
+		for (uint32_t p = 1; p < P; ++p) {
+			float error = distance2(texels[i], palette[p]);
+			if (error < best) {
+				best = error;
+				(*indices)[i] = uint8_t(p);
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+//BC1
+
+static uint16_t pack_565(Vec< 3 > const &color) {
+	uint32_t r = uint32_t(std::lround(color[0] * 31.0f / 255.0f));
+	uint32_t g = uint32_t(std::lround(color[1] * 63.0f / 255.0f));
+	uint32_t b = uint32_t(std::lround(color[2] * 31.0f / 255.0f));
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static Vec< 3 > unpack_565(uint16_t packed) {
+	uint32_t r = (packed >> 11) & 0x1f, g = (packed >> 5) & 0x3f, b = packed & 0x1f;
+	return Vec< 3 >{ float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)) };
+}
+
+//four-color palette in index order (endpoint 0, endpoint 1, then the two thirds between):
+static std::array< Vec< 3 >, 4 > bc1_palette(uint16_t c0, uint16_t c1) {
+	Vec< 3 > e0 = unpack_565(c0), e1 = unpack_565(c1);
+	std::array< Vec< 3 >, 4 > palette{ e0, e1 };
+	for (uint32_t c = 0; c < 3; ++c) {
+		palette[2][c] = std::floor((2.0f * e0[c] + e1[c]) / 3.0f);
+		palette[3][c] = std::floor((e0[c] + 2.0f * e1[c]) / 3.0f);
+	}
+	return palette;
+}
+
+void bc1_encode_block(uint8_t const rgba[64], uint8_t out[8]) {
+	static constexpr std::array< float, 4 > Weights{ 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	std::array< Vec< 3 >, 16 > texels = to_texels< 3 >(rgba, 4);
+	Vec< 3 > e0, e1;
+	principal_endpoints(texels, &e1, &e0);
+
+	uint16_t best_c0 = 0, best_c1 = 0;
+	std::array< uint8_t, 16 > best_indices{};
+	float best_error = INFINITY;
+	for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+		uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+		std::array< uint8_t, 16 > indices;
+		float error = choose_indices(texels, bc1_palette(c0, c1), &indices);
+		if (error < best_error) {
+			best_error = error;
+			best_c0 = c0;
+			best_c1 = c1;
+			best_indices = indices;
+		}
+		if (error == 0.0f) break;
+
+		std::array< float, 16 > weights;
+		for (uint32_t i = 0; i < 16; ++i) weights[i] = Weights[indices[i]];
+		if (!least_squares_endpoints(texels, weights, &e0, &e1)) break;
+	}
+
+	//c0 > c1 selects four-color mode; equal endpoints fall into three-color mode, where index 0 is still c0:
+	if (best_c0 < best_c1) {
+		std::swap(best_c0, best_c1);
+		for (uint8_t &index : best_indices) index ^= 1;
+	} else if (best_c0 == best_c1) {
+		best_indices.fill(0);
+	}
+
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; ++i) bits |= uint32_t(best_indices[i]) << (2 * i);
+	std::memcpy(out + 0, &best_c0, 2);
+	std::memcpy(out + 2, &best_c1, 2);
+	std::memcpy(out + 4, &bits, 4);
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+//BC4
+
+void bc4_encode_block(uint8_t const values[16], uint8_t out[8]) {
+	uint8_t lo = *std::min_element(values, values + 16);
+	uint8_t hi = *std::max_element(values, values + 16);
+
+	//r0 > r1 selects the eight-value palette (r0, r1, then six steps between):
+	std::array< Vec< 1 >, 8 > palette{ Vec< 1 >{ float(hi) }, Vec< 1 >{ float(lo) } };
+	for (uint32_t p = 2; p < 8; ++p) {
+		palette[p][0] = std::floor(((8.0f - p) * hi + (p - 1.0f) * lo) / 7.0f + 0.5f);
+	}
+
+	std::array< uint8_t, 16 > indices{};
+	if (hi != lo) choose_indices(to_texels< 1 >(values, 1), palette, &indices);
+
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 16; ++i) bits |= uint64_t(indices[i]) << (3 * i);
+	out[0] = hi;
+	out[1] = lo;
+	for (uint32_t b = 0; b < 6; ++b) out[2 + b] = uint8_t(bits >> (8 * b));
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+//BC7 (mode 6)
+
+static constexpr std::array< uint32_t, 16 > BC7Weights{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//an endpoint quantized to 7 bits per channel plus a shared low bit:
+struct BC7Endpoint {
+	std::array< uint8_t, 4 > bits7;
+	uint8_t p;
+	Vec< 4 > decoded() const {
+		Vec< 4 > color;
+		for (uint32_t c = 0; c < 4; ++c) color[c] = float((bits7[c] << 1) | p);
+		return color;
+	}
+};
+
+static BC7Endpoint quantize_bc7(Vec< 4 > const &color, uint8_t p) {
+	BC7Endpoint endpoint{ .bits7{}, .p = p };
+	for (uint32_t c = 0; c < 4; ++c) {
+		endpoint.bits7[c] = uint8_t(std::clamp(std::lround((color[c] - p) / 2.0f), 0l, 127l));
+	}
+	return endpoint;
+}
+
+static std::array< Vec< 4 >, 16 > bc7_palette(BC7Endpoint const &e0, BC7Endpoint const &e1) {
+	Vec< 4 > d0 = e0.decoded(), d1 = e1.decoded();
+	std::array< Vec< 4 >, 16 > palette;
+	for (uint32_t p = 0; p < 16; ++p) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			palette[p][c] = float(((64 - BC7Weights[p]) * uint32_t(d0[c]) + BC7Weights[p] * uint32_t(d1[c]) + 32) >> 6);
+		}
+	}
+	return palette;
+}
+
+//writes fields least-significant bit first, as BC7 blocks are laid out:
+struct BitWriter {
+	uint8_t *out;
+	uint32_t at = 0;
+	void write(uint32_t value, uint32_t count) {
+		for (uint32_t b = 0; b < count; ++b, ++at) {
+			if ((value >> b) & 1) out[at / 8] |= uint8_t(1 << (at % 8));
+		}
+	}
+};
+
+void bc7_encode_block(uint8_t const rgba[64], uint8_t out[16]) {
+	std::array< Vec< 4 >, 16 > texels = to_texels< 4 >(rgba, 4);
+	Vec< 4 > c0, c1;
+	principal_endpoints(texels, &c0, &c1);
+
+	BC7Endpoint best_e0{}, best_e1{};
+	std::array< uint8_t, 16 > best_indices{};
+	float best_error = INFINITY;
+	for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+		//try each combination of low bits:
+		for (uint8_t p = 0; p < 4; ++p) {
+			BC7Endpoint e0 = quantize_bc7(c0, p & 1), e1 = quantize_bc7(c1, p >> 1);
+			std::array< uint8_t, 16 > candidate;
+			float error = choose_indices(texels, bc7_palette(e0, e1), &candidate);
+			if (error < best_error) {
+				best_error = error;
+				best_e0 = e0;
+				best_e1 = e1;
+				best_indices = candidate;
+			}
+		}
+		if (best_error == 0.0f) break;
+
+		std::array< float, 16 > weights;
+		for (uint32_t i = 0; i < 16; ++i) weights[i] = BC7Weights[best_indices[i]] / 64.0f;
+		if (!least_squares_endpoints(texels, weights, &c0, &c1)) break;
+	}
+
+	//the first texel's index is stored without its high bit, so it must be < 8:
+	if (best_indices[0] >= 8) {
+		std::swap(best_e0, best_e1);
+		for (uint8_t &index : best_indices) index = uint8_t(15 - index);
+	}
+
+	std::memset(out, 0, 16);
+	BitWriter writer{ .out = out };
+	writer.write(1 << 6, 7); //mode 6
+	for (uint32_t c = 0; c < 4; ++c) {
+		writer.write(best_e0.bits7[c], 7);
+		writer.write(best_e1.bits7[c], 7);
+	}
+	writer.write(best_e0.p, 1);
+	writer.write(best_e1.p, 1);
+	for (uint32_t i = 0; i < 16; ++i) {
+		writer.write(best_indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+
+std::vector< uint8_t > bc_encode_image(VkFormat format, uint32_t width, uint32_t height, uint8_t const *rgba) {
+	uint32_t block_size;
+	if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK) {
+		block_size = 8;
+	} else if (format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK) {
+		block_size = 16;
+	} else {
+		throw std::runtime_error("bc_encode_image: unsupported format " + std::to_string(int(format)) + ".");
+	}
+
+	uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	std::vector< uint8_t > blocks(size_t(blocks_x) * blocks_y * block_size);
+	for (uint32_t by = 0; by < blocks_y; ++by) {
+		for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+			//gather the block (clamping at the right and top edges):
+			std::array< uint8_t, 64 > block;
+			for (uint32_t y = 0; y < 4; ++y) {
+				for (uint32_t x = 0; x < 4; ++x) {
+					uint32_t sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+					std::memcpy(&block[(y * 4 + x) * 4], rgba + (size_t(sy) * width + sx) * 4, 4);
+				}
+			}
+
+			uint8_t *out = &blocks[(size_t(by) * blocks_x + bx) * block_size];
+			if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+				std::array< uint8_t, 16 > red;
+				for (uint32_t i = 0; i < 16; ++i) red[i] = block[i * 4];
+				bc4_encode_block(red.data(), out);
+			} else if (block_size == 8) {
+				bc1_encode_block(block.data(), out);
+			} else {
+				bc7_encode_block(block.data(), out);
+			}
+		}
+	}
+	return blocks;
+}
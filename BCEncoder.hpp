@@ -0,0 +1,23 @@
+#pragma once
+
+//Block-compression (BCn) encoders used by TextureCompressor.
+//
+//Each *_block function encodes one 4x4 block of 8-bit texels (row-major, first row first):
+//  BC1 (8 bytes): opaque RGB, two 5:6:5 endpoints and 2-bit indices;
+//  BC4 (8 bytes): one channel, two 8-bit endpoints and 3-bit indices;
+//  BC7 (16 bytes): RGBA, always mode 6 (one subset, 7.7.7.7+1 endpoints and 4-bit indices).
+//Endpoints come from the block's principal axis and are refined by least squares, then indices are chosen by nearest color.
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+void bc1_encode_block(uint8_t const rgba[64], uint8_t out[8]);
+void bc4_encode_block(uint8_t const values[16], uint8_t out[8]);
+void bc7_encode_block(uint8_t const rgba[64], uint8_t out[16]);
+
+//encodes a whole width x height image of 8-bit RGBA texels (rows tightly packed) into `format`, block by block
+// (BC4 takes the red channel; edge blocks repeat the last row/column):
+// format is one of VK_FORMAT_BC1_RGB_*, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC7_*.
+std::vector< uint8_t > bc_encode_image(VkFormat format, uint32_t width, uint32_t height, uint8_t const *rgba);
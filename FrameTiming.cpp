@@ -0,0 +1,94 @@
+#include "FrameTiming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+void FrameTiming::push(Sample const &sample) {
+	uint64_t index = head.load(std::memory_order_relaxed);
+	Slot &slot = slots[index % Capacity];
+
+	//mark slot as being written, write, then mark as complete:
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.sample = sample;
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+	head.store(index + 1, std::memory_order_release);
+}
+
+bool FrameTiming::read(uint64_t index, Sample *sample) const {
+	Slot const &slot = slots[index % Capacity];
+	uint64_t before = slot.sequence.load(std::memory_order_acquire);
+	if (before != 2 * index + 2) return false; //not yet written, or already overwritten
+	*sample = slot.sample;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+	return after == before;
+}
+
+bool FrameTiming::latest(Sample *sample) const {
+	uint64_t end = head.load(std::memory_order_acquire);
+	if (end == 0) return false;
+	return read(end - 1, sample);
+}
+
+void FrameTiming::recent(uint32_t count, std::vector< Sample > *samples) const {
+	uint64_t end = head.load(std::memory_order_acquire);
+	count = uint32_t(std::min< uint64_t >({ count, end, Capacity }));
+	for (uint64_t index = end - count; index < end; ++index) {
+		Sample sample;
+		if (read(index, &sample)) samples->emplace_back(sample);
+	}
+}
+
+void FrameTiming::report(std::ostream &out) const {
+	std::vector< Sample > samples;
+	recent(Capacity, &samples);
+	if (samples.empty()) {
+		out << "Frame timing: no frames recorded." << std::endl;
+		return;
+	}
+
+	//nearest-rank percentile of sorted values:
+	auto percentile = [](std::vector< float > const &sorted, float p) {
+		size_t rank = size_t(std::ceil(p / 100.0f * sorted.size()));
+		return sorted[std::clamp< size_t >(rank, 1, sorted.size()) - 1];
+	};
+
+	auto row = [&](const char *name, std::vector< float > &values) {
+		std::sort(values.begin(), values.end());
+		out << "  " << std::setw(8) << name
+		    << std::setw(10) << values.front()
+		    << std::setw(10) << percentile(values, 50.0f)
+		    << std::setw(10) << percentile(values, 95.0f)
+		    << std::setw(10) << percentile(values, 99.0f)
+		    << std::setw(10) << values.back() << '\n';
+	};
+
+	std::ios_base::fmtflags flags = out.flags();
+	out << "Frame timing over the last " << samples.size() << " frames (milliseconds):\n";
+	out << std::fixed << std::setprecision(3);
+	out << "  " << std::setw(8) << "stage"
+	    << std::setw(10) << "min"
+	    << std::setw(10) << "median"
+	    << std::setw(10) << "p95"
+	    << std::setw(10) << "p99"
+	    << std::setw(10) << "max" << '\n';
+
+	std::vector< float > values(samples.size());
+	for (uint32_t stage = 0; stage < StageCount; ++stage) {
+		for (size_t i = 0; i < samples.size(); ++i) {
+			values[i] = samples[i].ms[stage];
+		}
+		row(StageNames[stage], values);
+	}
+	for (size_t i = 0; i < samples.size(); ++i) {
+		values[i] = samples[i].frame_ms;
+	}
+	row("frame", values);
+
+	out.flush();
+	out.flags(flags);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+//Per-frame CPU timing, recorded by RTG::run and readable by applications.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+struct FrameTiming {
+	//stages of a frame, in the order RTG::run performs them:
+	enum Stage : uint32_t {
+		Wait,    //waiting for the workspace_available fence (GPU back-pressure)
+		Acquire, //acquiring the next swapchain image
+		Update,  //Application::update
+		Render,  //Application::render (command recording + submit)
+		Present, //queueing the image for presentation
+		Other,   //everything else in the frame (event handling, untimed stages)
+		StageCount
+	};
+	static constexpr std::array< const char *, StageCount > StageNames{
+		"wait", "acquire", "update", "render", "present", "other"
+	};
+
+	struct Sample {
+		uint64_t frame = 0; //index of the frame, counting from zero at the start of RTG::run
+		std::array< float, StageCount > ms{}; //milliseconds spent in each stage
+		float frame_ms = 0.0f; //total milliseconds for the frame (sum of all stages)
+	};
+
+	//number of most recent frames kept:
+	static constexpr uint32_t Capacity = 4096;
+
+	//record a finished frame.
+	// NOTE: single producer -- only RTG::run should call this.
+	void push(Sample const &sample);
+
+	//fetch the most recently recorded frame; returns false if none have been recorded.
+	// (lock-free; safe to call from any thread)
+	bool latest(Sample *sample) const;
+
+	//append (up to) the `count` most recent frames to `samples`, oldest first.
+	// (lock-free; safe to call from any thread, though frames overwritten mid-copy are skipped)
+	void recent(uint32_t count, std::vector< Sample > *samples) const;
+
+	//print min/median/p95/p99/max for each stage over all kept frames:
+	void report(std::ostream &out) const;
+
+	//frames recorded so far (including those which have since been overwritten):
+	uint64_t recorded() const { return head.load(std::memory_order_acquire); }
+
+private:
+	//each slot is guarded by a sequence number (odd while being written) so readers can detect torn reads:
+	struct Slot {
+		std::atomic< uint64_t > sequence{0};
+		Sample sample;
+	};
+	std::unique_ptr< Slot[] > slots{ new Slot[Capacity] }; //(heap-allocated to keep RTG small)
+	std::atomic< uint64_t > head{0}; //index of next frame to be written
+	bool read(uint64_t index, Sample *sample) const;
+};
@@ -0,0 +1,107 @@
+#include "FrustumCull.hpp"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::from_clip(Mat4 const &clip_from_world) {
+	//rows of the (column-major) matrix:
+	auto row = [&](uint32_t r) {
+		return Vec4{ clip_from_world[0 * 4 + r], clip_from_world[1 * 4 + r], clip_from_world[2 * 4 + r], clip_from_world[3 * 4 + r] };
+	};
+	Vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+	auto plane = [](Vec4 const &a, float sign, Vec4 const &b) {
+		return Vec4{ a[0] + sign * b[0], a[1] + sign * b[1], a[2] + sign * b[2], a[3] + sign * b[3] };
+	};
+
+	Frustum frustum;
+	frustum.planes = {
+		plane(w,  1.0f, x), //left
+		plane(w, -1.0f, x), //right
+		plane(w,  1.0f, y), //top (clip y points down)
+		plane(w, -1.0f, y), //bottom
+		z,                  //near
+		plane(w, -1.0f, z), //far
+	};
+
+	//normalize, so distances are in world units (and comparable to sphere radii):
+	for (Vec4 &p : frustum.planes) {
+		float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (length > 0.0f) {
+			for (float &v : p) v /= length;
+		}
+	}
+	return frustum;
+}
+
+void SphereSoA::clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	r.clear();
+}
+
+void SphereSoA::push_back(float x_, float y_, float z_, float r_) {
+	x.emplace_back(x_);
+	y.emplace_back(y_);
+	z.emplace_back(z_);
+	r.emplace_back(r_);
+}
+
+//a sphere is culled if it lies entirely behind any plane, i.e. dot(n, center) + d < -radius:
+static bool sphere_visible(Frustum const &frustum, float x, float y, float z, float r) {
+	for (Vec4 const &p : frustum.planes) {
+		if (p[0] * x + p[1] * y + p[2] * z + p[3] < -r) return false;
+	}
+	return true;
+}
+
+void cull_spheres(Frustum const &frustum, SphereSoA const &spheres, std::vector< uint32_t > *visible_) {
+	assert(visible_);
+	auto &visible = *visible_;
+	uint32_t count = uint32_t(spheres.size());
+	uint32_t i = 0;
+
+#ifdef FRUSTUM_CULL_SSE
+	//four spheres per iteration:
+	__m128 planes[6][4];
+	for (uint32_t p = 0; p < 6; ++p) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+	}
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(spheres.x.data() + i);
+		__m128 y = _mm_loadu_ps(spheres.y.data() + i);
+		__m128 z = _mm_loadu_ps(spheres.z.data() + i);
+		__m128 neg_r = _mm_xor_ps(_mm_loadu_ps(spheres.r.data() + i), _mm_set1_ps(-0.0f)); //(flips the sign bit, like -r)
+
+		//(same operations, in the same order, as sphere_visible -- so both paths agree exactly)
+		__m128 outside = _mm_setzero_ps();
+		for (auto const &p : planes) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0], x), _mm_mul_ps(p[1], y)), _mm_mul_ps(p[2], z)), p[3]);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+		}
+
+		int mask = ~_mm_movemask_ps(outside) & 0xf;
+		while (mask) {
+			int bit = 0;
+			while (!(mask & (1 << bit))) ++bit;
+			visible.emplace_back(i + uint32_t(bit));
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	//remaining spheres (or all of them, without SSE):
+	for (; i < count; ++i) {
+		if (sphere_visible(frustum, spheres.x[i], spheres.y[i], spheres.z[i], spheres.r[i])) {
+			visible.emplace_back(i);
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+//Frustum culling of bounding spheres on the CPU.
+//Spheres are stored as a structure of arrays (all x, then all y, ...) so the test runs on four spheres at a time with SSE;
+// builds for other architectures use a scalar loop that gives the same results.
+
+#include "mat4.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct Frustum {
+	//planes as (nx, ny, nz, d) with unit normals pointing inward, so dot(n, p) + d is the signed distance from the plane to p:
+	// (left, right, top, bottom, near, far)
+	std::array< Vec4, 6 > planes{};
+
+	//extract the planes from a clip-from-world matrix (Vulkan clip space: -w <= x,y <= w and 0 <= z <= w):
+	static Frustum from_clip(Mat4 const &clip_from_world);
+};
+
+//bounding spheres, one array per component:
+struct SphereSoA {
+	std::vector< float > x, y, z, r;
+
+	void clear();
+	void push_back(float x, float y, float z, float r);
+	size_t size() const { return x.size(); }
+};
+
+//appends the index of every sphere that is at least partly inside `frustum` to *visible (in increasing order):
+void cull_spheres(Frustum const &frustum, SphereSoA const &spheres, std::vector< uint32_t > *visible);
@@ -6,9 +6,13 @@
 #include <vulkan/utility/vk_format_utils.h> // useful for byte counting
 
 #include <utility>
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string>
 
 Helpers::Allocation::Allocation(Allocation &&from) {
 	assert(handle == VK_NULL_HANDLE && offset == 0 && size == 0 && mapped == nullptr);
@@ -17,6 +21,8 @@ Helpers::Allocation::Allocation(Allocation &&from) {
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(memory_type_index, from.memory_type_index);
+	std::swap(tag, from.tag);
 }
 
 Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from) {
@@ -29,6 +35,8 @@ Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from) {
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(memory_type_index, from.memory_type_index);
+	std::swap(tag, from.tag);
 
 	return *this;
 }
@@ -41,23 +49,161 @@ Helpers::Allocation::~Allocation() {
 
 //----------------------------
 
-Helpers::Allocation Helpers::Allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, MapFlag map)
+static void CountAllocation(Helpers::MemoryStats::Counter &Counter, VkDeviceSize Bytes)
+{
+	Counter.bytes += Bytes;
+	Counter.count += 1;
+	Counter.peak_bytes = std::max(Counter.peak_bytes, Counter.bytes);
+}
+
+static void CountFree(Helpers::MemoryStats::Counter &Counter, VkDeviceSize Bytes)
+{
+	assert(Counter.bytes >= Bytes && Counter.count > 0);
+	Counter.bytes -= Bytes;
+	Counter.count -= 1;
+}
+
+static VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+	// (Vulkan alignments are always powers of two)
+	return (Value + Alignment - 1) & ~(Alignment - 1);
+}
+
+VkDeviceSize Helpers::BlockSizeForType(uint32_t MemoryTypeIndex) const
+{
+	// don't let a single block take more than an eighth of a (small) heap:
+	VkDeviceSize HeapSize = MemoryProperties.memoryHeaps[MemoryProperties.memoryTypes[MemoryTypeIndex].heapIndex].size;
+	return std::min(BlockSize, std::max< VkDeviceSize >(HeapSize / 8, 1024 * 1024));
+}
+
+Helpers::Allocation Helpers::Allocate(VkDeviceSize Size, VkDeviceSize Alignment, uint32_t MemoryTypeIndex, MapFlag Map, ResourceTiling Tiling)
+{
+	Size = std::max< VkDeviceSize >(Size, 1);
+	Alignment = std::max< VkDeviceSize >(Alignment, 1);
+
+	if (Map == Mapped && !(MemoryProperties.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+	{
+		throw std::runtime_error("Requested a mapped allocation from memory type " + std::to_string(MemoryTypeIndex) + ", which isn't host-visible.");
+	}
+
+	// big allocations would mostly waste a block, so they get their own memory:
+	VkDeviceSize TypeBlockSize = BlockSizeForType(MemoryTypeIndex);
+	if (Size > TypeBlockSize / 2)
+	{
+		return AllocateDedicated(Size, MemoryTypeIndex, Map);
+	}
+
+	// first fit, across existing blocks of the right kind:
+	auto TryBlock = [&](MemoryBlock &Block, VkDeviceSize *Offset) -> bool
+	{
+		for (auto Range = Block.FreeRanges.begin(); Range != Block.FreeRanges.end(); ++Range)
+		{
+			VkDeviceSize Begin = Range->first;
+			VkDeviceSize End = Range->first + Range->second;
+			VkDeviceSize Aligned = AlignUp(Begin, Alignment);
+			if (Aligned + Size > End) continue;
+
+			// split the free range around the allocation:
+			Block.FreeRanges.erase(Range);
+			if (Aligned > Begin) Block.FreeRanges.emplace(Begin, Aligned - Begin);
+			if (Aligned + Size < End) Block.FreeRanges.emplace(Aligned + Size, End - (Aligned + Size));
+
+			Block.Used += Size;
+			*Offset = Aligned;
+			return true;
+		}
+		return false;
+	};
+
+	MemoryBlock *Found = nullptr;
+	VkDeviceSize Offset = 0;
+	for (std::unique_ptr< MemoryBlock > &Block : MemoryBlocks)
+	{
+		if (Block->MemoryTypeIndex != MemoryTypeIndex || Block->Tiling != Tiling) continue;
+		if (Block->Size - Block->Used < Size) continue;
+		if (TryBlock(*Block, &Offset))
+		{
+			Found = Block.get();
+			break;
+		}
+	}
+
+	// no room anywhere, so make a new block:
+	if (Found == nullptr)
+	{
+		std::unique_ptr< MemoryBlock > Block = std::make_unique< MemoryBlock >();
+		Block->Size = TypeBlockSize;
+		Block->MemoryTypeIndex = MemoryTypeIndex;
+		Block->Tiling = Tiling;
+
+		VkMemoryAllocateInfo AllocationInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = Block->Size,
+			.memoryTypeIndex = MemoryTypeIndex
+		};
+		VK( vkAllocateMemory(rtg.device, &AllocationInfo, nullptr, &Block->Handle) );
+
+		if (MemoryProperties.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			VK( vkMapMemory(rtg.device, Block->Handle, 0, VK_WHOLE_SIZE, 0, &Block->Mapped) );
+		}
+
+		Block->FreeRanges.emplace(0, Block->Size);
+		CountAllocation(Tracked.heaps[MemoryProperties.memoryTypes[MemoryTypeIndex].heapIndex], Block->Size);
+
+		if (rtg.configuration.debug)
+		{
+			std::cout << "Allocated a " << (Block->Size / (1024 * 1024)) << "MiB " << (Tiling == OptimalResource ? "optimal" : "linear")
+			          << " block from memory type " << MemoryTypeIndex << " (" << (MemoryBlocks.size() + 1) << " blocks total)." << std::endl;
+		}
+
+		[[maybe_unused]] bool Fits = TryBlock(*Block, &Offset);
+		assert(Fits);
+		Found = Block.get();
+		MemoryBlocks.emplace_back(std::move(Block));
+	}
+
+	Helpers::Allocation AllocationTemp;
+	AllocationTemp.handle = Found->Handle;
+	AllocationTemp.offset = Offset;
+	AllocationTemp.size = Size;
+	AllocationTemp.memory_type_index = MemoryTypeIndex;
+	AllocationTemp.tag = CurrentTag;
+	CountAllocation(Tracked.types[MemoryTypeIndex], Size);
+	CountAllocation(Tracked.tags[CurrentTag], Size);
+	if (Map == Mapped)
+	{
+		// blocks are mapped as a whole, so data() == mapped + offset points at this allocation:
+		AllocationTemp.mapped = Found->Mapped;
+	}
+
+	return AllocationTemp;
+}
+
+Helpers::Allocation Helpers::AllocateDedicated(VkDeviceSize Size, uint32_t MemoryTypeIndex, MapFlag Map, void const *pNext)
 {
 	Helpers::Allocation AllocationTemp;
 
 	VkMemoryAllocateInfo AllocationInfo
 	{
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = size,
-		.memoryTypeIndex = memory_type_index
+		.pNext = pNext,
+		.allocationSize = Size,
+		.memoryTypeIndex = MemoryTypeIndex
 	};
 
 	VK( vkAllocateMemory( rtg.device, &AllocationInfo, nullptr, &AllocationTemp.handle ) );
 
-	AllocationTemp.size = size;
+	AllocationTemp.size = Size;
 	AllocationTemp.offset = 0;
+	AllocationTemp.memory_type_index = MemoryTypeIndex;
+	AllocationTemp.tag = CurrentTag;
+	CountAllocation(Tracked.types[MemoryTypeIndex], Size);
+	CountAllocation(Tracked.tags[CurrentTag], Size);
+	CountAllocation(Tracked.heaps[MemoryProperties.memoryTypes[MemoryTypeIndex].heapIndex], Size);
 
-	if (map == Mapped) 
+	if (Map == Mapped) 
 	{
 		VK( vkMapMemory(rtg.device, AllocationTemp.handle, 0, AllocationTemp.size, 0, &AllocationTemp.mapped) );
 	}
@@ -65,24 +211,159 @@ Helpers::Allocation Helpers::Allocate(VkDeviceSize size, VkDeviceSize alignment,
 	return AllocationTemp;
 }
 
-Helpers::Allocation Helpers::Allocate(VkMemoryRequirements const &req, VkMemoryPropertyFlags properties, MapFlag map)
+Helpers::Allocation Helpers::Allocate(VkMemoryRequirements const &req, VkMemoryPropertyFlags properties, MapFlag map, ResourceTiling tiling)
 {
-	return Allocate(req.size, req.alignment, FindMemoryType(req.memoryTypeBits, properties), map);
+	return Allocate(req.size, req.alignment, FindMemoryType(req.memoryTypeBits, properties), map, tiling);
 }
 
 void Helpers::Free(Helpers::Allocation &&Allocation)
 {
-	if(Allocation.mapped != nullptr)
+	if (Allocation.handle == VK_NULL_HANDLE) return;
+
+	CountFree(Tracked.types[Allocation.memory_type_index], Allocation.size);
+	CountFree(Tracked.tags[Allocation.tag], Allocation.size);
+	uint32_t HeapIndex = MemoryProperties.memoryTypes[Allocation.memory_type_index].heapIndex;
+
+	auto Owner = std::find_if(MemoryBlocks.begin(), MemoryBlocks.end(), [&](std::unique_ptr< MemoryBlock > const &Block)
+	{
+		return Block->Handle == Allocation.handle;
+	});
+
+	if (Owner != MemoryBlocks.end())
 	{
-		vkUnmapMemory(rtg.device, Allocation.handle);
-		Allocation.mapped = nullptr;
+		// return the range to its block, merging with free neighbours:
+		MemoryBlock &Block = **Owner;
+		VkDeviceSize Begin = Allocation.offset;
+		VkDeviceSize End = Allocation.offset + Allocation.size;
+
+		auto Next = Block.FreeRanges.lower_bound(Begin);
+		assert(Next == Block.FreeRanges.end() || Next->first >= End); // (double free?)
+		if (Next != Block.FreeRanges.end() && Next->first == End)
+		{
+			End = Next->first + Next->second;
+			Next = Block.FreeRanges.erase(Next);
+		}
+		if (Next != Block.FreeRanges.begin())
+		{
+			auto Prev = std::prev(Next);
+			if (Prev->first + Prev->second == Begin)
+			{
+				Begin = Prev->first;
+				Block.FreeRanges.erase(Prev);
+			}
+		}
+		Block.FreeRanges.emplace(Begin, End - Begin);
+		Block.Used -= Allocation.size;
+
+		// keep one empty block of each kind around (so buffers that are repeatedly re-created don't thrash), but release any others:
+		if (Block.Used == 0)
+		{
+			bool OtherEmpty = std::any_of(MemoryBlocks.begin(), MemoryBlocks.end(), [&](std::unique_ptr< MemoryBlock > const &Other)
+			{
+				return Other.get() != &Block && Other->Used == 0 && Other->MemoryTypeIndex == Block.MemoryTypeIndex && Other->Tiling == Block.Tiling;
+			});
+			if (OtherEmpty)
+			{
+				CountFree(Tracked.heaps[HeapIndex], Block.Size);
+				if (Block.Mapped) vkUnmapMemory(rtg.device, Block.Handle);
+				vkFreeMemory(rtg.device, Block.Handle, nullptr);
+				MemoryBlocks.erase(Owner);
+			}
+		}
 	}
+	else
+	{
+		// dedicated allocation:
+		if(Allocation.mapped != nullptr)
+		{
+			vkUnmapMemory(rtg.device, Allocation.handle);
+		}
 
-	vkFreeMemory(rtg.device, Allocation.handle, nullptr);
+		vkFreeMemory(rtg.device, Allocation.handle, nullptr);
+		CountFree(Tracked.heaps[HeapIndex], Allocation.size);
+	}
 
 	Allocation.handle = VK_NULL_HANDLE;
 	Allocation.offset = 0;
 	Allocation.size = 0;
+	Allocation.mapped = nullptr;
+	Allocation.memory_type_index = 0;
+	Allocation.tag = UntaggedMemory;
+}
+
+Helpers::MemoryStats Helpers::stats() const
+{
+	MemoryStats Stats = Tracked;
+
+	if (HasMemoryBudget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT Budget
+		{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		};
+		VkPhysicalDeviceMemoryProperties2 Properties
+		{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+			.pNext = &Budget,
+		};
+		vkGetPhysicalDeviceMemoryProperties2(rtg.physical_device, &Properties);
+
+		Stats.has_budget = true;
+		for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i)
+		{
+			Stats.heap_budget[i] = Budget.heapBudget[i];
+			Stats.heap_usage[i] = Budget.heapUsage[i];
+		}
+	}
+
+	return Stats;
+}
+
+void Helpers::report_stats(std::ostream &out) const
+{
+	MemoryStats Stats = stats();
+	auto MiB = [](VkDeviceSize Bytes) { return double(Bytes) / (1024.0 * 1024.0); };
+	auto Line = [&](MemoryStats::Counter const &Counter)
+	{
+		out << Counter.count << " allocations, " << MiB(Counter.bytes) << " MiB (peak " << MiB(Counter.peak_bytes) << " MiB)";
+	};
+
+	std::ios::fmtflags Flags = out.flags();
+	std::streamsize Precision = out.precision();
+	out << std::fixed << std::setprecision(2);
+
+	out << "Device memory by heap:\n";
+	for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i)
+	{
+		out << " [" << i << "] ";
+		Line(Stats.heaps[i]);
+		out << " of " << MiB(MemoryProperties.memoryHeaps[i].size) << " MiB";
+		if (Stats.has_budget)
+		{
+			out << "; process-wide usage " << MiB(Stats.heap_usage[i]) << " / budget " << MiB(Stats.heap_budget[i]) << " MiB";
+		}
+		out << '\n';
+	}
+	out << "Allocations by memory type:\n";
+	for (uint32_t i = 0; i < MemoryProperties.memoryTypeCount; ++i)
+	{
+		if (Stats.types[i].peak_bytes == 0) continue;
+		out << " [" << i << "] ";
+		Line(Stats.types[i]);
+		out << '\n';
+	}
+	out << "Allocations by tag:\n";
+	for (uint32_t Tag = 0; Tag < MemoryTagCount; ++Tag)
+	{
+		if (Stats.tags[Tag].peak_bytes == 0) continue;
+		out << " " << MemoryTagNames[Tag] << ": ";
+		Line(Stats.tags[Tag]);
+		out << '\n';
+	}
+	out.flush();
+
+	out.flags(Flags);
+	out.precision(Precision);
 }
 
 Helpers::AllocatedBuffer Helpers::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map) {
@@ -110,6 +391,41 @@ Helpers::AllocatedBuffer Helpers::create_buffer(VkDeviceSize size, VkBufferUsage
 	return buffer;
 }
 
+Helpers::AllocatedBuffer Helpers::create_host_writable_device_buffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	AllocatedBuffer buffer;
+	VkBufferCreateInfo CreateInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	VK( vkCreateBuffer(rtg.device, &CreateInfo, nullptr, &buffer.handle));
+	buffer.size = size;
+
+	VkMemoryRequirements Request;
+	vkGetBufferMemoryRequirements(rtg.device, buffer.handle, &Request);
+
+	// coherent so CPU writes need no flush; (uncached, write-combined memory is preferred by not asking for HOST_CACHED)
+	std::optional< uint32_t > MemoryTypeIndex = SelectMemoryType
+	(
+		Request.memoryTypeBits,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	if (!MemoryTypeIndex)
+	{
+		vkDestroyBuffer(rtg.device, buffer.handle, nullptr);
+		return AllocatedBuffer{};
+	}
+
+	buffer.allocation = Allocate(Request.size, Request.alignment, *MemoryTypeIndex, Mapped);
+
+	VK( vkBindBufferMemory(rtg.device, buffer.handle, buffer.allocation.handle, buffer.allocation.offset));
+
+	return buffer;
+}
+
 void Helpers::destroy_buffer(AllocatedBuffer &&buffer) 
 {
 	vkDestroyBuffer(rtg.device, buffer.handle, nullptr);
@@ -119,11 +435,14 @@ void Helpers::destroy_buffer(AllocatedBuffer &&buffer)
 	this->Free(std::move(buffer.allocation));
 }
 
-Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map) {
+Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map, uint32_t mip_levels) {
+	assert(mip_levels >= 1 && mip_levels <= mip_count(extent));
+
 	AllocatedImage image;
 	
 	image.extent = extent;
 	image.format = format;
+	image.mip_levels = mip_levels;
 
 	VkImageCreateInfo CreateInfo
 	{
@@ -136,7 +455,7 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 			.height = extent.height,
 			.depth = 1
 		},
-		.mipLevels = 1,
+		.mipLevels = mip_levels,
 		.arrayLayers = 1,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = tiling,
@@ -147,10 +466,38 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 
 	VK( vkCreateImage(rtg.device, &CreateInfo, nullptr, &image.handle));
 
-	VkMemoryRequirements Require;
-	vkGetImageMemoryRequirements(rtg.device, image.handle, &Require);
+	// check whether the driver would rather give this image its own memory:
+	VkMemoryDedicatedRequirements DedicatedRequire
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+	};
+	VkMemoryRequirements2 Require2
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+		.pNext = &DedicatedRequire,
+	};
+	VkImageMemoryRequirementsInfo2 RequireInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+		.image = image.handle,
+	};
+	vkGetImageMemoryRequirements2(rtg.device, &RequireInfo, &Require2);
+	VkMemoryRequirements const &Require = Require2.memoryRequirements;
 
-	image.allocation = Allocate(Require, properties, map);
+	uint32_t MemoryTypeIndex = FindMemoryType(Require.memoryTypeBits, properties);
+	if (DedicatedRequire.prefersDedicatedAllocation || DedicatedRequire.requiresDedicatedAllocation || Require.size > BlockSizeForType(MemoryTypeIndex) / 2)
+	{
+		VkMemoryDedicatedAllocateInfo DedicatedInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+			.image = image.handle,
+		};
+		image.allocation = AllocateDedicated(Require.size, MemoryTypeIndex, map, &DedicatedInfo);
+	}
+	else
+	{
+		image.allocation = Allocate(Require.size, Require.alignment, MemoryTypeIndex, map, tiling == VK_IMAGE_TILING_OPTIMAL ? OptimalResource : LinearResource);
+	}
 
 	VK( vkBindImageMemory(rtg.device, image.handle, image.allocation.handle, image.allocation.offset));
 
@@ -164,100 +511,216 @@ void Helpers::destroy_image(AllocatedImage &&image)
 	image.handle = VK_NULL_HANDLE;
 	image.extent = VkExtent2D{.width = 0, .height = 0};
 	image.format = VK_FORMAT_UNDEFINED;
+	image.mip_levels = 1;
 
 	this->Free(std::move(image.allocation));
 }
 
+uint32_t Helpers::mip_count(VkExtent2D const &extent)
+{
+	return uint32_t(std::bit_width(std::max(extent.width, extent.height)));
+}
+
+size_t Helpers::mip_level_size(VkFormat format, VkExtent2D const &extent, uint32_t mip_level)
+{
+	VkExtent3D Block = vkuFormatTexelBlockExtent(format);
+	size_t Width = std::max(extent.width >> mip_level, 1u);
+	size_t Height = std::max(extent.height >> mip_level, 1u);
+	return ((Width + Block.width - 1) / Block.width) * ((Height + Block.height - 1) / Block.height) * vkuFormatTexelBlockSize(format);
+}
+
 //----------------------------
 
 void Helpers::transfer_to_buffer(void const *data, size_t size, AllocatedBuffer &target) 
 {
-	// NOTE: could let this stick around and use it for all uploads, but this function isn't for performant transfers anyway:
-	AllocatedBuffer TransferSrc = create_buffer
-	(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		Mapped
-	);
-	
-	// copy data to transfer buffer
-	std::memcpy(TransferSrc.allocation.data(), data, size);
+	queue_buffer_upload(data, size, target);
+	wait_for_upload(submit_uploads());
+}
+
+void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &target) 
+{
+	queue_image_upload(data, size, target);
+	wait_for_upload(submit_uploads());
+}
+
+Helpers::UploadBatch &Helpers::BeginUpload()
+{
+	if (CurrentUpload) return *CurrentUpload;
+
+	RetireUploads();
+
+	if (!FreeUploadBatches.empty())
+	{
+		CurrentUpload = std::move(FreeUploadBatches.back());
+		FreeUploadBatches.pop_back();
+	}
+	else
+	{
+		CurrentUpload = std::make_unique< UploadBatch >();
+
+		VkCommandBufferAllocateInfo AllocInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = TransferCommandPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+		VK( vkAllocateCommandBuffers(rtg.device, &AllocInfo, &CurrentUpload->CommandBuffer) );
+
+		VkFenceCreateInfo FenceInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		};
+		VK( vkCreateFence(rtg.device, &FenceInfo, nullptr, &CurrentUpload->Done) );
+
+		if (rtg.transfer_queue != VK_NULL_HANDLE)
+		{
+			VkSemaphoreCreateInfo SemaphoreInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			};
+			VK( vkCreateSemaphore(rtg.device, &SemaphoreInfo, nullptr, &CurrentUpload->Ready) );
+		}
+	}
 
-	// record CPU->GPU transfer to command buffer
+	VK( vkResetCommandBuffer(CurrentUpload->CommandBuffer, 0) );
 	VkCommandBufferBeginInfo BeginInfo
 	{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // will record again every submit
 	};
-	VK( vkBeginCommandBuffer(TransferCommandBuffer, &BeginInfo));
+	VK( vkBeginCommandBuffer(CurrentUpload->CommandBuffer, &BeginInfo) );
 
-	VkBufferCopy CopyRegion
-	{
-		.srcOffset = 0,
-		.dstOffset = 0,
-		.size = size
-	};
-	vkCmdCopyBuffer(TransferCommandBuffer, TransferSrc.handle, target.handle, 1, &CopyRegion);
+	return *CurrentUpload;
+}
 
-	VK( vkEndCommandBuffer(TransferCommandBuffer) );
+void *Helpers::UploadStaging(size_t size, VkBuffer *buffer, VkDeviceSize *offset)
+{
+	UploadBatch &Batch = BeginUpload();
 
-	// run command buffer
+	// (16 satisfies buffer->image copy offset rules for all the formats used here)
+	VkDeviceSize Begin = (Batch.StagingUsed + 15) & ~VkDeviceSize(15);
+	if (Batch.Staging.empty() || Begin + size > Batch.Staging.back().size)
 	{
-		VkSubmitInfo SubmitInfo
+		// need another staging buffer; reuse a big-enough one from the pool if possible:
+		auto Found = std::find_if(StagingPool.begin(), StagingPool.end(), [&](AllocatedBuffer const &Buffer)
 		{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &TransferCommandBuffer
-		};
+			return Buffer.size >= size;
+		});
+		if (Found != StagingPool.end())
+		{
+			Batch.Staging.emplace_back(std::move(*Found));
+			StagingPool.erase(Found);
+		}
+		else
+		{
+			Batch.Staging.emplace_back(CreateStagingBuffer(std::max< VkDeviceSize >(size, StagingBufferSize)));
+		}
+		Begin = 0;
+	}
+
+	Batch.StagingUsed = Begin + size;
+	*buffer = Batch.Staging.back().handle;
+	*offset = Begin;
+	return reinterpret_cast< char * >(Batch.Staging.back().allocation.data()) + Begin;
+}
 
-		VK( vkQueueSubmit(rtg.graphics_queue, 1, &SubmitInfo, VK_NULL_HANDLE));
+Helpers::AllocatedBuffer Helpers::CreateStagingBuffer(VkDeviceSize size)
+{
+	TagScope Tag(*this, StagingMemory);
+	if (rtg.transfer_queue == VK_NULL_HANDLE)
+	{
+		return create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Mapped);
 	}
 
-	// wait for command buffer to finish
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+	std::array< uint32_t, 2 > QueueFamilies{ rtg.graphics_queue_family.value(), rtg.transfer_queue_family.value() };
+	AllocatedBuffer buffer;
+	VkBufferCreateInfo CreateInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_CONCURRENT,
+		.queueFamilyIndexCount = uint32_t(QueueFamilies.size()),
+		.pQueueFamilyIndices = QueueFamilies.data(),
+	};
+	VK( vkCreateBuffer(rtg.device, &CreateInfo, nullptr, &buffer.handle));
+	buffer.size = size;
+
+	VkMemoryRequirements Request;
+	vkGetBufferMemoryRequirements(rtg.device, buffer.handle, &Request);
+	buffer.allocation = Allocate(Request, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Mapped);
+	VK( vkBindBufferMemory(rtg.device, buffer.handle, buffer.allocation.handle, buffer.allocation.offset));
 
-	//don't leak buffer memory:
-	destroy_buffer(std::move(TransferSrc));
+	return buffer;
 }
 
-void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &target) 
+void Helpers::queue_buffer_upload(void const *data, size_t size, AllocatedBuffer &target, VkDeviceSize target_offset)
 {
-	assert(target.handle != VK_NULL_HANDLE);	// target iamgen should be allocated already
+	assert(target.handle != VK_NULL_HANDLE);
+	assert(target_offset + size <= target.size);
 
-	// check data is the right size
-	size_t BytesPerBlock = vkuFormatTexelBlockSize(target.format);
-	size_t TexelsPerBlock = vkuFormatTexelsPerBlock(target.format);
-	assert(size == target.extent.width * target.extent.height * BytesPerBlock / TexelsPerBlock);
+	VkBuffer StagingBuffer = VK_NULL_HANDLE;
+	VkDeviceSize StagingOffset = 0;
+	std::memcpy(UploadStaging(size, &StagingBuffer, &StagingOffset), data, size);
 
-	// create a host-coherent source buffer
-	AllocatedBuffer TransferSrc = create_buffer
-	(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		Mapped
-	);
+	VkBufferCopy CopyRegion
+	{
+		.srcOffset = StagingOffset,
+		.dstOffset = target_offset,
+		.size = size
+	};
+	vkCmdCopyBuffer(CurrentUpload->CommandBuffer, StagingBuffer, target.handle, 1, &CopyRegion);
 
-	// copy image data into the source buffer
-	std::memcpy(TransferSrc.allocation.data(), data, size);
+	ReleaseUpload(target.handle, target_offset, size);
+}
 
-	// begin recording a command buffer
-	VK(vkResetCommandBuffer(TransferCommandBuffer, 0));
+void Helpers::queue_image_upload(void const *data, size_t size, AllocatedImage &target)
+{
+	std::memcpy(QueueImageUpload(target, size, 1), data, size);
+}
 
-	VkCommandBufferBeginInfo BeginInfo
+void *Helpers::queue_image_upload_into(AllocatedImage &target, size_t size)
+{
+	return QueueImageUpload(target, size, 1);
+}
+
+void Helpers::queue_image_levels_upload(void const *data, size_t size, AllocatedImage &target)
+{
+	std::memcpy(QueueImageUpload(target, size, target.mip_levels), data, size);
+}
+
+void *Helpers::queue_image_levels_upload_into(AllocatedImage &target, size_t size)
+{
+	return QueueImageUpload(target, size, target.mip_levels);
+}
+
+void *Helpers::QueueImageUpload(AllocatedImage &target, size_t size, uint32_t provided_levels)
+{
+	assert(target.handle != VK_NULL_HANDLE);	// target image should be allocated already
+	assert(provided_levels == 1 || provided_levels == target.mip_levels);
+
+	// check data is the right size
+	size_t ExpectedSize = 0;
+	for (uint32_t Level = 0; Level < provided_levels; ++Level)
 	{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // will record again every submit
-	};
+		ExpectedSize += mip_level_size(target.format, target.extent, Level);
+	}
+	assert(size == ExpectedSize);
+	(void)ExpectedSize;
+
+	// reserve staging memory (the caller fills it in before submit_uploads)
+	VkBuffer StagingBuffer = VK_NULL_HANDLE;
+	VkDeviceSize StagingOffset = 0;
+	void *Staging = UploadStaging(size, &StagingBuffer, &StagingOffset);
+
+	VkCommandBuffer CommandBuffer = CurrentUpload->CommandBuffer;
 
-	VK(vkBeginCommandBuffer(TransferCommandBuffer, &BeginInfo));
-	
 	VkImageSubresourceRange WholeImage
 	{
 		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 		.baseMipLevel = 0,
-		.levelCount = 1,
+		.levelCount = target.mip_levels,
 		.baseArrayLayer = 0,
 		.layerCount = 1,
 	};
@@ -279,7 +742,7 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 
 		vkCmdPipelineBarrier
 		(
-			TransferCommandBuffer, 				// commandBuffer
+			CommandBuffer, 						// commandBuffer
 			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 	// srcStageMask
 			VK_PIPELINE_STAGE_TRANSFER_BIT, 	// dstStageMask
 			0, // dependencyFlags
@@ -288,100 +751,974 @@ void Helpers::transfer_to_image(void const *data, size_t size, AllocatedImage &t
 			1, &Barrier // image memory barrier count, pointer
 		);
 	}
-	// copy the source buffer to the image
+	// copy the staging memory to the image (one region per provided level, packed tightly)
 	{
-		VkBufferImageCopy Region
+		std::vector< VkBufferImageCopy > Regions;
+		Regions.reserve(provided_levels);
+		VkDeviceSize LevelOffset = StagingOffset;
+		for (uint32_t Level = 0; Level < provided_levels; ++Level)
 		{
-			.bufferOffset = 0,
-			.bufferRowLength = target.extent.width,
-			.bufferImageHeight = target.extent.height,
-			.imageSubresource
-			{
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
-			},
-			.imageOffset{ .x = 0, .y = 0, .z = 0 },
-			.imageExtent
+			Regions.emplace_back(VkBufferImageCopy
 			{
-				.width = target.extent.width,
-				.height = target.extent.height,
-				.depth = 1
-			},
-		};
+				.bufferOffset = LevelOffset,
+				.bufferRowLength = 0, // (tightly packed)
+				.bufferImageHeight = 0,
+				.imageSubresource
+				{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.mipLevel = Level,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+				.imageOffset{ .x = 0, .y = 0, .z = 0 },
+				.imageExtent
+				{
+					.width = std::max(target.extent.width >> Level, 1u),
+					.height = std::max(target.extent.height >> Level, 1u),
+					.depth = 1
+				},
+			});
+			LevelOffset += mip_level_size(target.format, target.extent, Level);
+		}
 
 		vkCmdCopyBufferToImage
 		(
-			TransferCommandBuffer,
-			TransferSrc.handle,
+			CommandBuffer,
+			StagingBuffer,
 			target.handle,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, &Region
+			uint32_t(Regions.size()), Regions.data()
 		);
 
-		// NOTE: if image had mip levels, would need to copy as additional regions here.
 	}
 
-	// transition the image memory to shader-read-only-optimal layout
+	if (provided_levels == target.mip_levels)
 	{
-		VkImageMemoryBarrier Barrier
+		// transition the image memory to shader-read-only-optimal layout
+		ReleaseUpload(target.handle, WholeImage);
+		return Staging;
+	}
+
+	// the rest of the levels are blitted down from level 0:
+	{
+		VkFormatProperties Props;
+		vkGetPhysicalDeviceFormatProperties(rtg.physical_device, target.format, &Props);
+		VkFormatFeatureFlags Needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((Props.optimalTilingFeatures & Needed) != Needed)
 		{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = target.handle,
-			.subresourceRange = WholeImage,
-		};
+			throw std::runtime_error(std::string("Can't generate mip levels for format ") + string_VkFormat(target.format) + " (no linear blit support).");
+		}
+	}
 
-		vkCmdPipelineBarrier
+	if (rtg.transfer_queue == VK_NULL_HANDLE)
+	{
+		RecordMipChain(CommandBuffer, target.handle, target.extent, target.mip_levels);
+		return Staging;
+	}
+
+	// blits need the graphics queue, so hand the image over still in transfer-dst layout; acquire_uploads() generates the mip chain:
+	VkImageMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0, // (ignored by a release)
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = rtg.transfer_queue_family.value(),
+		.dstQueueFamilyIndex = rtg.graphics_queue_family.value(),
+		.image = target.handle,
+		.subresourceRange = WholeImage,
+	};
+
+	vkCmdPipelineBarrier
+	(
+		CommandBuffer, // commandBuffer
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, // dstStageMask (the acquire barrier does the waiting)
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+
+	Barrier.srcAccessMask = 0;
+	Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	CurrentUpload->MipAcquires.emplace_back(Barrier);
+	CurrentUpload->MipExtents.emplace_back(target.extent);
+	return Staging;
+}
+
+void Helpers::queue_image_region_upload(void const *data, size_t size, AllocatedImage &target, VkRect2D const &region, uint32_t mip_level)
+{
+	assert(target.handle != VK_NULL_HANDLE);
+	assert(mip_level < target.mip_levels);
+	assert(region.offset.x >= 0 && region.offset.y >= 0);
+	assert(uint32_t(region.offset.x) + region.extent.width <= std::max(target.extent.width >> mip_level, 1u));
+	assert(uint32_t(region.offset.y) + region.extent.height <= std::max(target.extent.height >> mip_level, 1u));
+
+	size_t BytesPerBlock = vkuFormatTexelBlockSize(target.format);
+	size_t TexelsPerBlock = vkuFormatTexelsPerBlock(target.format);
+	assert(size == region.extent.width * region.extent.height * BytesPerBlock / TexelsPerBlock);
+	(void)BytesPerBlock; (void)TexelsPerBlock;
+
+	UploadBatch::RegionCopy Region
+	{
+		.Image = target.handle,
+	};
+	VkDeviceSize StagingOffset = 0;
+	std::memcpy(UploadStaging(size, &Region.Staging, &StagingOffset), data, size);
+
+	Region.Copy = VkBufferImageCopy
+	{
+		.bufferOffset = StagingOffset,
+		.bufferRowLength = region.extent.width,
+		.bufferImageHeight = region.extent.height,
+		.imageSubresource
+		{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = mip_level,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageOffset{ .x = region.offset.x, .y = region.offset.y, .z = 0 },
+		.imageExtent{ .width = region.extent.width, .height = region.extent.height, .depth = 1 },
+	};
+
+	// the image belongs to the graphics queue (and its other texels must be kept), so the copy has to happen there:
+	if (rtg.transfer_queue == VK_NULL_HANDLE)
+	{
+		RecordRegionCopy(CurrentUpload->CommandBuffer, Region.Staging, Region.Image, Region.Copy);
+	}
+	else
+	{
+		CurrentUpload->RegionCopies.emplace_back(Region);
+	}
+}
+
+void Helpers::RecordRegionCopy(VkCommandBuffer command_buffer, VkBuffer staging, VkImage image, VkBufferImageCopy const &copy)
+{
+	VkImageMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = 0, // (earlier shader reads only need to finish before the write)
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // (not UNDEFINED: the rest of the level is kept)
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange
+		{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = copy.imageSubresource.mipLevel,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+
+	vkCmdPipelineBarrier
+	(
+		command_buffer, // commandBuffer
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+
+	vkCmdCopyBufferToImage(command_buffer, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+	Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	vkCmdPipelineBarrier
+	(
+		command_buffer, // commandBuffer
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+}
+
+void Helpers::RecordMipChain(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, uint32_t levels)
+{
+	assert(levels > 1);
+
+	VkImageMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange
+		{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+
+	int32_t Width = int32_t(extent.width);
+	int32_t Height = int32_t(extent.height);
+	for (uint32_t Level = 1; Level < levels; ++Level)
+	{
+		// the previous level has been written; read from it:
+		Barrier.subresourceRange.baseMipLevel = Level - 1;
+		vkCmdPipelineBarrier
 		(
-			TransferCommandBuffer, 			// commandBuffer
+			command_buffer, // commandBuffer
 			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
 			0, // dependencyFlags
 			0, nullptr, // memory barrier count, pointer
 			0, nullptr, // buffer memory barrier count, pointer
 			1, &Barrier // image memory barrier count, pointer
 		);
+
+		int32_t NextWidth = std::max(Width / 2, 1);
+		int32_t NextHeight = std::max(Height / 2, 1);
+		VkImageBlit Blit
+		{
+			.srcSubresource
+			{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = Level - 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.srcOffsets{ VkOffset3D{ .x = 0, .y = 0, .z = 0 }, VkOffset3D{ .x = Width, .y = Height, .z = 1 } },
+			.dstSubresource
+			{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = Level,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.dstOffsets{ VkOffset3D{ .x = 0, .y = 0, .z = 0 }, VkOffset3D{ .x = NextWidth, .y = NextHeight, .z = 1 } },
+		};
+		vkCmdBlitImage
+		(
+			command_buffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &Blit,
+			VK_FILTER_LINEAR
+		);
+
+		Width = NextWidth;
+		Height = NextHeight;
+	}
+
+	// every level but the last was read from (so is in transfer-src layout); the last was only written:
+	std::array< VkImageMemoryBarrier, 2 > Final{ Barrier, Barrier };
+	Final[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	Final[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	Final[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	Final[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	Final[0].subresourceRange.baseMipLevel = 0;
+	Final[0].subresourceRange.levelCount = levels - 1;
+	Final[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	Final[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	Final[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	Final[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	Final[1].subresourceRange.baseMipLevel = levels - 1;
+	Final[1].subresourceRange.levelCount = 1;
+
+	vkCmdPipelineBarrier
+	(
+		command_buffer, // commandBuffer
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		uint32_t(Final.size()), Final.data() // image memory barrier count, pointer
+	);
+}
+
+void Helpers::ReleaseUpload(VkBuffer target, VkDeviceSize offset, VkDeviceSize size)
+{
+	// on the graphics queue, submit_uploads() ends the batch with one memory barrier covering every buffer copy:
+	if (rtg.transfer_queue == VK_NULL_HANDLE) return;
+
+	VkBufferMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0, // (ignored by a release)
+		.srcQueueFamilyIndex = rtg.transfer_queue_family.value(),
+		.dstQueueFamilyIndex = rtg.graphics_queue_family.value(),
+		.buffer = target,
+		.offset = offset,
+		.size = size,
+	};
+
+	vkCmdPipelineBarrier
+	(
+		CurrentUpload->CommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, // dstStageMask (the acquire barrier does the waiting)
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		1, &Barrier, // buffer memory barrier count, pointer
+		0, nullptr // image memory barrier count, pointer
+	);
+
+	// the matching acquire, recorded on the graphics queue by acquire_uploads():
+	Barrier.srcAccessMask = 0;
+	Barrier.dstAccessMask = UploadConsumerAccess;
+	CurrentUpload->BufferAcquires.emplace_back(Barrier);
+}
+
+void Helpers::ReleaseUpload(VkImage target, VkImageSubresourceRange const &range)
+{
+	VkImageMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = target,
+		.subresourceRange = range,
+	};
+	VkPipelineStageFlags DstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	// on a transfer queue, the layout transition is part of a queue family ownership release:
+	// (both halves of the transfer must name the same layouts)
+	if (rtg.transfer_queue != VK_NULL_HANDLE)
+	{
+		Barrier.dstAccessMask = 0; // (ignored by a release)
+		Barrier.srcQueueFamilyIndex = rtg.transfer_queue_family.value();
+		Barrier.dstQueueFamilyIndex = rtg.graphics_queue_family.value();
+		DstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT; // (the acquire barrier does the waiting)
+	}
+
+	vkCmdPipelineBarrier
+	(
+		CurrentUpload->CommandBuffer, 	// commandBuffer
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		DstStage, // dstStageMask
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+
+	if (rtg.transfer_queue != VK_NULL_HANDLE)
+	{
+		// the matching acquire, recorded on the graphics queue by acquire_uploads():
+		Barrier.srcAccessMask = 0;
+		Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		CurrentUpload->ImageAcquires.emplace_back(Barrier);
+	}
+}
+
+Helpers::UploadTicket Helpers::submit_uploads()
+{
+	if (!CurrentUpload) return 0;
+	std::unique_ptr< UploadBatch > Batch = std::move(CurrentUpload);
+
+	// make buffer copies visible to anything submitted later (image uploads already end with their own barriers):
+	// (on a transfer queue, every copy already ended with an ownership release instead)
+	if (rtg.transfer_queue == VK_NULL_HANDLE)
+	{
+		VkMemoryBarrier MemoryBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = UploadConsumerAccess,
+		};
+
+		vkCmdPipelineBarrier
+		(
+			Batch->CommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+			UploadConsumerStages, // dstStageMask
+			0, // dependencyFlags
+			1, &MemoryBarrier, // memory barrier count, pointer
+			0, nullptr, // buffer memory barrier count, pointer
+			0, nullptr // image memory barrier count, pointer
+		);
 	}
 
-	// end and submit the command buffer
-	VK(vkEndCommandBuffer(TransferCommandBuffer));
+	VK( vkEndCommandBuffer(Batch->CommandBuffer) );
 
 	VkSubmitInfo SubmitInfo
 	{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &TransferCommandBuffer
+		.pCommandBuffers = &Batch->CommandBuffer,
+		.signalSemaphoreCount = (Batch->Ready != VK_NULL_HANDLE ? 1u : 0u),
+		.pSignalSemaphores = &Batch->Ready,
+	};
+	VkQueue Queue = (rtg.transfer_queue != VK_NULL_HANDLE ? rtg.transfer_queue : rtg.graphics_queue);
+	VK( vkQueueSubmit(Queue, 1, &SubmitInfo, Batch->Done) );
+
+	Batch->Ticket = NextUploadTicket++;
+	UploadTicket Ticket = Batch->Ticket;
+	PendingUploads.emplace_back(std::move(Batch));
+
+	// graphics-queue uploads are ordered before every later graphics submit, so there's nothing to hand over:
+	if (rtg.transfer_queue == VK_NULL_HANDLE)
+	{
+		AcquiredUploadTicket = Ticket;
+	}
+	return Ticket;
+}
+
+void Helpers::acquire_uploads(VkCommandBuffer command_buffer, VkFence submit_fence, std::vector< VkSemaphore > *wait_semaphores, std::vector< VkPipelineStageFlags > *wait_stages, UploadTicket through)
+{
+	assert(wait_semaphores && wait_stages);
+	if (rtg.transfer_queue == VK_NULL_HANDLE) return;
+	assert(submit_fence != VK_NULL_HANDLE && "need a fence to know when upload semaphores can be reused");
+
+	RetireUploads(); // (notices newly finished batches)
+
+	std::vector< VkBufferMemoryBarrier > BufferBarriers;
+	std::vector< VkImageMemoryBarrier > ImageBarriers;
+	std::vector< VkImageMemoryBarrier > MipBarriers;
+	std::vector< VkExtent2D > MipExtents;
+	std::vector< UploadBatch::RegionCopy > RegionCopies;
+	for (std::unique_ptr< UploadBatch > const &Batch : PendingUploads)
+	{
+		if (Batch->Ticket <= AcquiredUploadTicket) continue;
+		// (batches are acquired in submission order, so upload_acquired() can just compare tickets)
+		if (!Batch->Finished && Batch->Ticket > through) break;
+
+		BufferBarriers.insert(BufferBarriers.end(), Batch->BufferAcquires.begin(), Batch->BufferAcquires.end());
+		ImageBarriers.insert(ImageBarriers.end(), Batch->ImageAcquires.begin(), Batch->ImageAcquires.end());
+		MipBarriers.insert(MipBarriers.end(), Batch->MipAcquires.begin(), Batch->MipAcquires.end());
+		MipExtents.insert(MipExtents.end(), Batch->MipExtents.begin(), Batch->MipExtents.end());
+		RegionCopies.insert(RegionCopies.end(), Batch->RegionCopies.begin(), Batch->RegionCopies.end());
+		Batch->GraphicsReadsStaging = !Batch->RegionCopies.empty();
+		Batch->RegionCopies.clear();
+		bool HasMips = !Batch->MipAcquires.empty();
+		Batch->BufferAcquires.clear();
+		Batch->ImageAcquires.clear();
+		Batch->MipAcquires.clear();
+		Batch->MipExtents.clear();
+
+		// (a finished batch's semaphore is already signaled, so waiting on it costs nothing; it still has to be waited on to be reused)
+		wait_semaphores->emplace_back(Batch->Ready);
+		wait_stages->emplace_back(UploadConsumerStages | (HasMips || Batch->GraphicsReadsStaging ? VK_PIPELINE_STAGE_TRANSFER_BIT : 0));
+		Batch->AcquiredBy = submit_fence;
+		AcquiredUploadTicket = Batch->Ticket;
+	}
+
+	if (!BufferBarriers.empty() || !ImageBarriers.empty())
+	{
+		vkCmdPipelineBarrier
+		(
+			command_buffer,
+			UploadConsumerStages, // srcStageMask (matches the semaphore wait stages, so the barrier comes after the wait)
+			UploadConsumerStages, // dstStageMask
+			0, // dependencyFlags
+			0, nullptr, // memory barrier count, pointer
+			uint32_t(BufferBarriers.size()), BufferBarriers.data(), // buffer memory barrier count, pointer
+			uint32_t(ImageBarriers.size()), ImageBarriers.data() // image memory barrier count, pointer
+		);
+	}
+
+	// images that still need their mip chains generated:
+	if (!MipBarriers.empty())
+	{
+		vkCmdPipelineBarrier
+		(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask (also a semaphore wait stage for these batches)
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+			0, // dependencyFlags
+			0, nullptr, // memory barrier count, pointer
+			0, nullptr, // buffer memory barrier count, pointer
+			uint32_t(MipBarriers.size()), MipBarriers.data() // image memory barrier count, pointer
+		);
+		for (size_t i = 0; i < MipBarriers.size(); ++i)
+		{
+			RecordMipChain(command_buffer, MipBarriers[i].image, MipExtents[i], MipBarriers[i].subresourceRange.levelCount);
+		}
+	}
+
+	// sub-region updates of images the graphics queue already owns:
+	for (UploadBatch::RegionCopy const &Region : RegionCopies)
+	{
+		RecordRegionCopy(command_buffer, Region.Staging, Region.Image, Region.Copy);
+	}
+}
+
+void Helpers::RetireUploads()
+{
+	// is `Fence` known to have signaled?
+	auto Signaled = [this](VkFence Fence)
+	{
+		if (Fence == VK_NULL_HANDLE) return false;
+		VkResult Result = vkGetFenceStatus(rtg.device, Fence);
+		if (Result == VK_NOT_READY) return false;
+		VK( Result );
+		return true;
 	};
 
-	VK(vkQueueSubmit(rtg.graphics_queue, 1, &SubmitInfo, VK_NULL_HANDLE));
+	for (auto Iter = PendingUploads.begin(); Iter != PendingUploads.end(); )
+	{
+		UploadBatch &Batch = **Iter;
+		if (!Batch.Finished && Signaled(Batch.Done))
+		{
+			Batch.Finished = true;
+		}
 
-	// wait for command buffer to finish executing
-	VK( vkQueueWaitIdle(rtg.graphics_queue));
+		// with a transfer queue, the batch (and its semaphore) can only be reused once the submit that waited on it has finished:
+		// (AcquiredBy may be a fence that was reset and reused since; that just delays this until it signals again)
+		bool Reusable = Batch.Finished && (Batch.Ready == VK_NULL_HANDLE || Signaled(Batch.AcquiredBy));
 
-	// destroy the source buffer
-	destroy_buffer(std::move(TransferSrc));
+		// the batch's staging buffers can be reused once nothing reads them:
+		if (Batch.Finished && (!Batch.GraphicsReadsStaging || Reusable))
+		{
+			for (AllocatedBuffer &Buffer : Batch.Staging)
+			{
+				StagingPool.emplace_back(std::move(Buffer));
+			}
+			Batch.Staging.clear();
+		}
+
+		if (!Reusable)
+		{
+			++Iter;
+			continue;
+		}
+
+		Batch.StagingUsed = 0;
+		Batch.Ticket = 0;
+		Batch.Finished = false;
+		Batch.GraphicsReadsStaging = false;
+		Batch.AcquiredBy = VK_NULL_HANDLE;
+		VK( vkResetFences(rtg.device, 1, &Batch.Done) );
+
+		FreeUploadBatches.emplace_back(std::move(*Iter));
+		Iter = PendingUploads.erase(Iter);
+	}
+
+	// don't hold on to more idle staging memory than is likely to be useful (biggest buffers go first):
+	VkDeviceSize PoolBytes = 0;
+	for (AllocatedBuffer const &Buffer : StagingPool) PoolBytes += Buffer.size;
+	while (PoolBytes > StagingPoolKeep)
+	{
+		auto Biggest = std::max_element(StagingPool.begin(), StagingPool.end(), [](AllocatedBuffer const &A, AllocatedBuffer const &B)
+		{
+			return A.size < B.size;
+		});
+		PoolBytes -= Biggest->size;
+		destroy_buffer(std::move(*Biggest));
+		StagingPool.erase(Biggest);
+	}
+}
+
+bool Helpers::upload_finished(UploadTicket ticket)
+{
+	if (ticket == 0) return true;
+	assert(ticket < NextUploadTicket && "ticket from a batch that was never submitted");
+
+	RetireUploads();
+	return std::none_of(PendingUploads.begin(), PendingUploads.end(), [&](std::unique_ptr< UploadBatch > const &Batch)
+	{
+		return Batch->Ticket == ticket && !Batch->Finished;
+	});
+}
+
+void Helpers::wait_for_upload(UploadTicket ticket)
+{
+	if (ticket == 0) return;
+
+	for (std::unique_ptr< UploadBatch > const &Batch : PendingUploads)
+	{
+		if (Batch->Ticket == ticket && !Batch->Finished)
+		{
+			VK( vkWaitForFences(rtg.device, 1, &Batch->Done, VK_TRUE, UINT64_MAX) );
+			break;
+		}
+	}
+	RetireUploads();
 }
 
 //----------------------------
 
-uint32_t Helpers::FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags flags) const
+Helpers::Readback &Helpers::BeginReadback(VkDeviceSize size, bool own_submit)
 {
+	Readback &Result = Readbacks.emplace_back();
+	Result.Ticket = NextReadbackTicket++;
+	Result.Size = size;
+
+	// host-cached memory makes CPU reads fast; it might not be coherent, so the allocation is padded out to whole atoms (see take_readback):
+	{
+		TagScope Tag(*this, ReadbackMemory);
+		VkDeviceSize Padded = (size + NonCoherentAtomSize - 1) / NonCoherentAtomSize * NonCoherentAtomSize;
+		VkBufferCreateInfo CreateInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = Padded,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+		VK( vkCreateBuffer(rtg.device, &CreateInfo, nullptr, &Result.Buffer.handle) );
+		Result.Buffer.size = size;
+
+		VkMemoryRequirements Request;
+		vkGetBufferMemoryRequirements(rtg.device, Result.Buffer.handle, &Request);
+		uint32_t MemoryTypeIndex = FindMemoryType(Request.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		Result.Buffer.allocation = Allocate(std::max(Request.size, Padded), std::max(Request.alignment, NonCoherentAtomSize), MemoryTypeIndex, Mapped);
+		VK( vkBindBufferMemory(rtg.device, Result.Buffer.handle, Result.Buffer.allocation.handle, Result.Buffer.allocation.offset) );
+	}
+
+	if (own_submit)
+	{
+		ReadbackSubmit Submit;
+		if (!FreeReadbackSubmits.empty())
+		{
+			Submit = FreeReadbackSubmits.back();
+			FreeReadbackSubmits.pop_back();
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo AllocInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = ReadbackCommandPool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1
+			};
+			VK( vkAllocateCommandBuffers(rtg.device, &AllocInfo, &Submit.CommandBuffer) );
+
+			VkFenceCreateInfo FenceInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			};
+			VK( vkCreateFence(rtg.device, &FenceInfo, nullptr, &Submit.Done) );
+		}
+		Result.CommandBuffer = Submit.CommandBuffer;
+		Result.Done = Submit.Done;
+
+		VK( vkResetCommandBuffer(Result.CommandBuffer, 0) );
+		VkCommandBufferBeginInfo BeginInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+		VK( vkBeginCommandBuffer(Result.CommandBuffer, &BeginInfo) );
+	}
+
+	return Result;
+}
+
+Helpers::ReadbackTicket Helpers::SubmitReadback(Readback &readback)
+{
+	VK( vkEndCommandBuffer(readback.CommandBuffer) );
+
+	VkSubmitInfo SubmitInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &readback.CommandBuffer
+	};
+	VK( vkQueueSubmit(rtg.graphics_queue, 1, &SubmitInfo, readback.Done) );
+
+	return readback.Ticket;
+}
+
+Helpers::ReadbackTicket Helpers::readback_buffer(AllocatedBuffer const &source, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (size == VK_WHOLE_SIZE) size = source.size - offset;
+	assert(offset + size <= source.size);
+
+	Readback &Result = BeginReadback(size, true);
+
+	// earlier graphics-queue work might still be writing source:
+	VkMemoryBarrier Before
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+	};
+	vkCmdPipelineBarrier
+	(
+		Result.CommandBuffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+		0, // dependencyFlags
+		1, &Before, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		0, nullptr // image memory barrier count, pointer
+	);
+
+	VkBufferCopy CopyRegion
+	{
+		.srcOffset = offset,
+		.dstOffset = 0,
+		.size = size
+	};
+	vkCmdCopyBuffer(Result.CommandBuffer, source.handle, Result.Buffer.handle, 1, &CopyRegion);
+
+	VkMemoryBarrier After
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+	};
+	vkCmdPipelineBarrier
+	(
+		Result.CommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_HOST_BIT, // dstStageMask
+		0, // dependencyFlags
+		1, &After, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		0, nullptr // image memory barrier count, pointer
+	);
+
+	return SubmitReadback(Result);
+}
+
+Helpers::ReadbackTicket Helpers::readback_image(AllocatedImage const &source, VkImageLayout layout, uint32_t mip_level)
+{
+	assert(mip_level < source.mip_levels);
+	VkExtent2D Extent
+	{
+		.width = std::max(source.extent.width >> mip_level, 1u),
+		.height = std::max(source.extent.height >> mip_level, 1u),
+	};
+	VkDeviceSize Size = VkDeviceSize(Extent.width) * Extent.height * vkuFormatTexelBlockSize(source.format) / vkuFormatTexelsPerBlock(source.format);
+
+	Readback &Result = BeginReadback(Size, true);
+	RecordImageReadback(Result.CommandBuffer, source.handle, source.format, Extent, layout, mip_level, Result.Buffer.handle);
+	return SubmitReadback(Result);
+}
+
+Helpers::ReadbackTicket Helpers::record_image_readback(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout)
+{
+	VkDeviceSize Size = VkDeviceSize(extent.width) * extent.height * vkuFormatTexelBlockSize(format) / vkuFormatTexelsPerBlock(format);
+
+	Readback &Result = BeginReadback(Size, false);
+	RecordImageReadback(command_buffer, image, format, extent, layout, 0, Result.Buffer.handle);
+	return Result.Ticket;
+}
+
+void Helpers::submit_recorded_readbacks()
+{
+	for (Readback &Entry : Readbacks)
+	{
+		if (Entry.CommandBuffer != VK_NULL_HANDLE || Entry.Done != VK_NULL_HANDLE) continue;
+
+		if (!FreeReadbackFences.empty())
+		{
+			Entry.Done = FreeReadbackFences.back();
+			FreeReadbackFences.pop_back();
+		}
+		else
+		{
+			VkFenceCreateInfo FenceInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			};
+			VK( vkCreateFence(rtg.device, &FenceInfo, nullptr, &Entry.Done) );
+		}
+
+		// (a submit with no batches still signals its fence, once all work previously submitted to the queue has completed)
+		VK( vkQueueSubmit(rtg.graphics_queue, 0, nullptr, Entry.Done) );
+	}
+}
+
+void Helpers::RecordImageReadback(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, uint32_t mip_level, VkBuffer target)
+{
+	(void)format;
+
+	VkImageMemoryBarrier Barrier
+	{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT, // (whatever wrote the image before)
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = layout,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange
+		{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = mip_level,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+
+	vkCmdPipelineBarrier
+	(
+		command_buffer, // commandBuffer
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		0, nullptr, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+
+	VkBufferImageCopy Region
+	{
+		.bufferOffset = 0,
+		.bufferRowLength = extent.width,
+		.bufferImageHeight = extent.height,
+		.imageSubresource
+		{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = mip_level,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageOffset{ .x = 0, .y = 0, .z = 0 },
+		.imageExtent{ .width = extent.width, .height = extent.height, .depth = 1 },
+	};
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, 1, &Region);
+
+	// put the image back the way it was, and make the copy visible to the host:
+	Barrier.srcAccessMask = 0; // (only reads happened)
+	Barrier.dstAccessMask = 0;
+	Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	Barrier.newLayout = layout;
+	VkBufferMemoryBarrier ToHost
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = target,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+
+	vkCmdPipelineBarrier
+	(
+		command_buffer, // commandBuffer
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, // dstStageMask (later users of the image; the host)
+		0, // dependencyFlags
+		0, nullptr, // memory barrier count, pointer
+		1, &ToHost, // buffer memory barrier count, pointer
+		1, &Barrier // image memory barrier count, pointer
+	);
+}
+
+bool Helpers::take_readback(ReadbackTicket ticket, std::vector< uint8_t > *data, bool wait)
+{
+	assert(data);
+	auto Found = std::find_if(Readbacks.begin(), Readbacks.end(), [&](Readback const &Entry)
+	{
+		return Entry.Ticket == ticket;
+	});
+	if (Found == Readbacks.end())
+	{
+		throw std::runtime_error("Readback ticket " + std::to_string(ticket) + " is unknown (or was already taken).");
+	}
+
+	if (Found->Done == VK_NULL_HANDLE)
+	{
+		// (recorded, but not yet passed to submit_recorded_readbacks, so there is nothing to wait for)
+		if (wait)
+		{
+			throw std::runtime_error("Readback ticket " + std::to_string(ticket) + " was recorded but never submitted.");
+		}
+		return false;
+	}
+
+	if (wait)
+	{
+		VK( vkWaitForFences(rtg.device, 1, &Found->Done, VK_TRUE, UINT64_MAX) );
+	}
+	else
+	{
+		VkResult Result = vkGetFenceStatus(rtg.device, Found->Done);
+		if (Result == VK_NOT_READY) return false;
+		VK( Result );
+	}
+
+	// non-coherent memory needs the (atom-aligned) range invalidated before reading:
+	Allocation const &Memory = Found->Buffer.allocation;
+	if (!(MemoryProperties.memoryTypes[Memory.memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		VkMappedMemoryRange Range
+		{
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = Memory.handle,
+			.offset = Memory.offset,
+			.size = (Found->Size + NonCoherentAtomSize - 1) / NonCoherentAtomSize * NonCoherentAtomSize,
+		};
+		VK( vkInvalidateMappedMemoryRanges(rtg.device, 1, &Range) );
+	}
+
+	uint8_t const *Bytes = reinterpret_cast< uint8_t const * >(Memory.data());
+	data->assign(Bytes, Bytes + Found->Size);
+
+	VK( vkResetFences(rtg.device, 1, &Found->Done) );
+	if (Found->CommandBuffer != VK_NULL_HANDLE)
+	{
+		FreeReadbackSubmits.emplace_back(ReadbackSubmit{ .CommandBuffer = Found->CommandBuffer, .Done = Found->Done });
+	}
+	else
+	{
+		FreeReadbackFences.emplace_back(Found->Done);
+	}
+	destroy_buffer(std::move(Found->Buffer));
+	Readbacks.erase(Found);
+	return true;
+}
+
+//----------------------------
+
+std::optional< uint32_t > Helpers::SelectMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred) const
+{
+	std::optional< uint32_t > Best;
+	int BestScore = 0;
 	for (uint32_t i = 0; i < MemoryProperties.memoryTypeCount; ++i) 
 	{
-		VkMemoryType const &type = MemoryProperties.memoryTypes[i];
-		if ((TypeFilter & (1 << i)) != 0
-		 && (type.propertyFlags & flags) == flags) 
-		 {
-			return i;
+		VkMemoryType const &Type = MemoryProperties.memoryTypes[i];
+		if ((TypeFilter & (1 << i)) == 0) continue;
+		if ((Type.propertyFlags & Required) != Required) continue;
+
+		// protected memory can't be used for ordinary resources:
+		VkMemoryPropertyFlags Unasked = Type.propertyFlags & ~(Required | Preferred);
+		if (Unasked & VK_MEMORY_PROPERTY_PROTECTED_BIT) continue;
+
+		// each preferred flag is worth more than any number of unasked-for flags;
+		// unasked-for flags cost a little (e.g., so device-only resources don't use up host-visible device memory):
+		int Score = 16 * std::popcount(uint32_t(Type.propertyFlags & Preferred)) - std::popcount(uint32_t(Unasked));
+		if (!Best || Score > BestScore)
+		{
+			Best = i;
+			BestScore = Score;
 		}
 	}
+	return Best;
+}
+
+uint32_t Helpers::FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred) const
+{
+	if (std::optional< uint32_t > Index = SelectMemoryType(TypeFilter, Required, Preferred))
+	{
+		return *Index;
+	}
 	throw std::runtime_error("No suitable memory type found.");
 }
 
@@ -430,20 +1767,37 @@ void Helpers::create()
 	{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-		.queueFamilyIndex = rtg.graphics_queue_family.value(),
+		.queueFamilyIndex = rtg.transfer_queue_family.value_or(rtg.graphics_queue_family.value()),
 	};
 	VK( vkCreateCommandPool(rtg.device, &CreateInfo, nullptr, &TransferCommandPool) );
 
-	VkCommandBufferAllocateInfo AllocInfo
+	vkGetPhysicalDeviceMemoryProperties(rtg.physical_device, &MemoryProperties);
+
 	{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = TransferCommandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1
-	};
-	VK( vkAllocateCommandBuffers(rtg.device, &AllocInfo, &TransferCommandBuffer) );
+		VkCommandPoolCreateInfo ReadbackPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			.queueFamilyIndex = rtg.graphics_queue_family.value(),
+		};
+		VK( vkCreateCommandPool(rtg.device, &ReadbackPoolInfo, nullptr, &ReadbackCommandPool) );
 
-	vkGetPhysicalDeviceMemoryProperties(rtg.physical_device, &MemoryProperties);
+		VkPhysicalDeviceProperties Properties;
+		vkGetPhysicalDeviceProperties(rtg.physical_device, &Properties);
+		NonCoherentAtomSize = Properties.limits.nonCoherentAtomSize;
+	}
+
+	// VK_EXT_memory_budget only extends a physical-device query, so it just needs to be supported:
+	{
+		uint32_t Count = 0;
+		VK( vkEnumerateDeviceExtensionProperties(rtg.physical_device, nullptr, &Count, nullptr) );
+		std::vector< VkExtensionProperties > Extensions(Count);
+		VK( vkEnumerateDeviceExtensionProperties(rtg.physical_device, nullptr, &Count, Extensions.data()) );
+		HasMemoryBudget = std::any_of(Extensions.begin(), Extensions.end(), [](VkExtensionProperties const &Extension)
+		{
+			return std::strcmp(Extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+		});
+	}
 
 	if(rtg.configuration.debug)
 	{
@@ -465,12 +1819,47 @@ void Helpers::create()
 
 void Helpers::destroy() 
 {
-	// Technically not needed since freeing the pool will free all contained buffers:
-	if(TransferCommandBuffer != VK_NULL_HANDLE)
+	// finish (or abandon) any uploads:
+	if (CurrentUpload)
+	{
+		std::cerr << "Uploads were queued but never submitted; discarding them." << std::endl;
+		VK( vkEndCommandBuffer(CurrentUpload->CommandBuffer) );
+		for (AllocatedBuffer &Buffer : CurrentUpload->Staging)
+		{
+			StagingPool.emplace_back(std::move(Buffer));
+		}
+		CurrentUpload->Staging.clear();
+		FreeUploadBatches.emplace_back(std::move(CurrentUpload));
+	}
+	// (RTG waits for the device to be idle first, so no submit is still waiting on a batch's Ready semaphore either)
+	for (std::unique_ptr< UploadBatch > &Batch : PendingUploads)
+	{
+		VK( vkWaitForFences(rtg.device, 1, &Batch->Done, VK_TRUE, UINT64_MAX) );
+		for (AllocatedBuffer &Buffer : Batch->Staging)
+		{
+			StagingPool.emplace_back(std::move(Buffer));
+		}
+		Batch->Staging.clear();
+		FreeUploadBatches.emplace_back(std::move(Batch));
+	}
+	PendingUploads.clear();
+
+	for (AllocatedBuffer &Buffer : StagingPool)
 	{
-		vkFreeCommandBuffers(rtg.device, TransferCommandPool, 1, &TransferCommandBuffer);
-		TransferCommandBuffer = VK_NULL_HANDLE;
+		destroy_buffer(std::move(Buffer));
 	}
+	StagingPool.clear();
+
+	// (command buffers are freed with the pool)
+	for (std::unique_ptr< UploadBatch > &Batch : FreeUploadBatches)
+	{
+		vkDestroyFence(rtg.device, Batch->Done, nullptr);
+		if (Batch->Ready != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(rtg.device, Batch->Ready, nullptr);
+		}
+	}
+	FreeUploadBatches.clear();
 
 	if(TransferCommandPool != VK_NULL_HANDLE)
 	{
@@ -478,4 +1867,58 @@ void Helpers::destroy()
 		TransferCommandPool = VK_NULL_HANDLE;
 	}
 
+	// (the device is idle, so no readback is still being written)
+	if (!Readbacks.empty())
+	{
+		std::cerr << Readbacks.size() << " readbacks were never taken; discarding them." << std::endl;
+	}
+	for (Readback &Entry : Readbacks)
+	{
+		if (Entry.CommandBuffer != VK_NULL_HANDLE)
+		{
+			FreeReadbackSubmits.emplace_back(ReadbackSubmit{ .CommandBuffer = Entry.CommandBuffer, .Done = Entry.Done });
+		}
+		else if (Entry.Done != VK_NULL_HANDLE)
+		{
+			FreeReadbackFences.emplace_back(Entry.Done);
+		}
+		destroy_buffer(std::move(Entry.Buffer));
+	}
+	Readbacks.clear();
+	for (ReadbackSubmit &Submit : FreeReadbackSubmits)
+	{
+		vkDestroyFence(rtg.device, Submit.Done, nullptr);
+	}
+	FreeReadbackSubmits.clear();
+	for (VkFence Fence : FreeReadbackFences)
+	{
+		vkDestroyFence(rtg.device, Fence, nullptr);
+	}
+	FreeReadbackFences.clear();
+	if (ReadbackCommandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(rtg.device, ReadbackCommandPool, nullptr);
+		ReadbackCommandPool = VK_NULL_HANDLE;
+	}
+
+	if (rtg.configuration.debug)
+	{
+		report_stats(std::cout);
+	}
+
+	// leak report:
+	for (uint32_t Tag = 0; Tag < MemoryTagCount; ++Tag)
+	{
+		if (Tracked.tags[Tag].count != 0)
+		{
+			std::cerr << "Leaked " << Tracked.tags[Tag].count << " allocations (" << Tracked.tags[Tag].bytes << " bytes) tagged '" << MemoryTagNames[Tag] << "'." << std::endl;
+		}
+	}
+
+	for (std::unique_ptr< MemoryBlock > &Block : MemoryBlocks)
+	{
+		if (Block->Mapped) vkUnmapMemory(rtg.device, Block->Handle);
+		vkFreeMemory(rtg.device, Block->Handle, nullptr);
+	}
+	MemoryBlocks.clear();
 }
@@ -2,6 +2,11 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <map>
+#include <memory>
+#include <optional>
+#include <array>
+#include <iosfwd>
 #include <vector>
 
 struct RTG;
@@ -11,12 +16,29 @@ struct Helpers {
 	//-----------------------
 	//memory allocation:
 
+	//What allocations are for (used for statistics and leak reports):
+	enum MemoryTag : uint32_t {
+		UntaggedMemory,
+		TextureMemory,
+		VertexMemory,
+		WorkspaceMemory, //per-workspace (per-frame) buffers
+		SwapchainMemory, //swapchain-sized images (depth, headless targets)
+		StagingMemory, //temporary transfer buffers
+		ReadbackMemory, //GPU -> CPU copies waiting to be taken
+		MemoryTagCount
+	};
+	static constexpr std::array< const char *, MemoryTagCount > MemoryTagNames{
+		"untagged", "textures", "vertices", "per-workspace", "swapchain", "staging", "readback"
+	};
+
 	//An owning reference to (part of) a slab of device memory:
 	struct Allocation {
 		VkDeviceMemory handle = VK_NULL_HANDLE;
 		VkDeviceSize offset = 0; //offset of the allocated object inside the memory
 		VkDeviceSize size = 0; //size of the allocated object inside the memory (might be *larger* than the internal size of the object!)
 		void *mapped = nullptr;
+		uint32_t memory_type_index = 0; //(for statistics)
+		MemoryTag tag = UntaggedMemory; //(for statistics)
 		void *data() const { return reinterpret_cast< char * >(mapped) + offset; } //get pointer to beginning of allocation, taking offset into account
 
 		//Call an all-zero (no handle, offset, size, mapped) Allocation "empty":
@@ -31,15 +53,77 @@ struct Helpers {
 		Mapped = 1,
 	};
 
+	// Linear resources (buffers, linearly-tiled images) and optimally-tiled images are sub-allocated from separate blocks,
+	// so neighbours in a block never need to be padded out to bufferImageGranularity:
+	enum ResourceTiling {
+		LinearResource = 0,
+		OptimalResource = 1,
+	};
+
 	// Allocate a block of requested size and alignment from a memory with the given type index:
-	Allocation Allocate(VkDeviceSize Size, VkDeviceSize Alignment, uint32_t Memory_type_index, MapFlag Map = Unmapped);
+	Allocation Allocate(VkDeviceSize Size, VkDeviceSize Alignment, uint32_t Memory_type_index, MapFlag Map = Unmapped, ResourceTiling Tiling = LinearResource);
 
 	// Allocate a block that works for a given VkMemoryRequirements and VkMemoryPropertyFlags:
-	Allocation Allocate(VkMemoryRequirements const &Requirements, VkMemoryPropertyFlags Memory_properties, MapFlag Map = Unmapped);
+	Allocation Allocate(VkMemoryRequirements const &Requirements, VkMemoryPropertyFlags Memory_properties, MapFlag Map = Unmapped, ResourceTiling Tiling = LinearResource);
+
+	// Allocate a whole VkDeviceMemory for one resource (pNext may hold, e.g., a VkMemoryDedicatedAllocateInfo):
+	Allocation AllocateDedicated(VkDeviceSize Size, uint32_t Memory_type_index, MapFlag Map = Unmapped, void const *pNext = nullptr);
 
 	// free an allocated block:
 	void Free(Allocation &&Allocation);
 
+	// Device memory is allocated in large blocks per (memory type, tiling); Allocate() hands out aligned pieces of them.
+	// Host-visible blocks are mapped once, when created, and stay mapped until they are freed.
+	static constexpr VkDeviceSize BlockSize = 64 * 1024 * 1024; // (smaller on small heaps)
+	struct MemoryBlock
+	{
+		VkDeviceMemory Handle = VK_NULL_HANDLE;
+		VkDeviceSize Size = 0;
+		VkDeviceSize Used = 0; // bytes currently handed out (not counting alignment padding)
+		uint32_t MemoryTypeIndex = 0;
+		ResourceTiling Tiling = LinearResource;
+		void *Mapped = nullptr; // base of the block's mapping, if host-visible
+		std::map< VkDeviceSize, VkDeviceSize > FreeRanges; // offset -> size; adjacent ranges are always merged
+	};
+	std::vector< std::unique_ptr< MemoryBlock > > MemoryBlocks;
+	VkDeviceSize BlockSizeForType(uint32_t MemoryTypeIndex) const;
+
+	//new allocations are tagged with CurrentTag; use a TagScope to set it for a stretch of code:
+	MemoryTag CurrentTag = UntaggedMemory;
+	struct TagScope {
+		TagScope(Helpers &helpers_, MemoryTag tag) : helpers(helpers_), previous(helpers_.CurrentTag) { helpers.CurrentTag = tag; }
+		TagScope(TagScope const &) = delete;
+		~TagScope() { helpers.CurrentTag = previous; }
+		Helpers &helpers;
+		MemoryTag previous;
+	};
+
+	//-----------------------
+	//memory statistics:
+
+	struct MemoryStats {
+		struct Counter {
+			VkDeviceSize bytes = 0; //live bytes
+			uint64_t count = 0; //live allocations
+			VkDeviceSize peak_bytes = 0; //most live bytes at any one time
+		};
+		std::array< Counter, VK_MAX_MEMORY_TYPES > types; //allocations handed out, by memory type
+		std::array< Counter, MemoryTagCount > tags; //allocations handed out, by MemoryTag
+		std::array< Counter, VK_MAX_MEMORY_HEAPS > heaps; //VkDeviceMemory objects (blocks and dedicated allocations), by heap
+
+		//from VK_EXT_memory_budget, if available (includes other processes' usage of the heap):
+		bool has_budget = false;
+		std::array< VkDeviceSize, VK_MAX_MEMORY_HEAPS > heap_budget{};
+		std::array< VkDeviceSize, VK_MAX_MEMORY_HEAPS > heap_usage{};
+	};
+	//current statistics (budget numbers are queried fresh on every call):
+	MemoryStats stats() const;
+	//print statistics in a human-readable form:
+	void report_stats(std::ostream &out) const;
+
+	MemoryStats Tracked; //(maintained by Allocate, AllocateDedicated, and Free; stats() adds budget info)
+	bool HasMemoryBudget = false; //VK_EXT_memory_budget is supported by the physical device
+
 	//specializations that also create a buffer or image (respectively):
 	struct AllocatedBuffer {
 		VkBuffer handle = VK_NULL_HANDLE;
@@ -49,36 +133,171 @@ struct Helpers {
 		//NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
 	};
 	AllocatedBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+	//a mapped buffer in memory that is both device-local and host-visible (resizable BAR, UMA), so the CPU can write directly to what the GPU reads;
+	// returns an empty buffer (handle == VK_NULL_HANDLE) if the device has no such memory:
+	AllocatedBuffer create_host_writable_device_buffer(VkDeviceSize size, VkBufferUsageFlags usage);
 	void destroy_buffer(AllocatedBuffer &&allocated_buffer);
 
 	struct AllocatedImage {
 		VkImage handle = VK_NULL_HANDLE;
 		VkExtent2D extent{.width = 0, .height = 0};
 		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mip_levels = 1;
 		Allocation allocation;
 
 		//NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
 	};
-	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+	//NOTE: images with more than one mip level that are uploaded from a single level of data get the rest generated with linear blits (so also need VK_IMAGE_USAGE_TRANSFER_SRC_BIT):
+	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped, uint32_t mip_levels = 1);
+	//number of levels in a full mip chain (down to 1x1) for an image of this size:
+	static uint32_t mip_count(VkExtent2D const &extent);
+	//bytes of tightly-packed data in one mip level (whole texel blocks, so block-compressed formats round up to 4x4):
+	static size_t mip_level_size(VkFormat format, VkExtent2D const &extent, uint32_t mip_level);
 	void destroy_image(AllocatedImage &&allocated_image);
 	
 
 	//-----------------------
 	//CPU -> GPU data transfer:
 
-	// NOTE: synchronizes *hard* against the GPU; inefficient to use for streaming data!
+	// NOTE: waits for the copy to finish (but the graphics queue must still acquire the target; see acquire_uploads); use the batched versions below where possible!
 	void transfer_to_buffer(void const *data, size_t size, AllocatedBuffer &target);
 	void transfer_to_image(void const *data, size_t size, AllocatedImage &image); //NOTE: image layout after call is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 
-	VkCommandPool TransferCommandPool = VK_NULL_HANDLE;
-	VkCommandBuffer TransferCommandBuffer = VK_NULL_HANDLE;
+	// Batched, asynchronous transfers:
+	//  queue_*_upload() copies data into a (reused) staging buffer right away and records the copy into the current batch;
+	//  submit_uploads() submits everything queued so far as one command buffer, and returns a ticket for it.
+	// Uploads run on rtg.transfer_queue if there is one (so they overlap rendering), otherwise on rtg.graphics_queue.
+	// Either way, the graphics queue may only use the targets once their batch has been *acquired* (see acquire_uploads);
+	// tickets are for the CPU (e.g., before destroying or re-uploading a target).
+	// NOTE: on a transfer queue, uploading into part of a resource the graphics queue has already used leaves the rest of it undefined.
+	using UploadTicket = uint64_t;
+	void queue_buffer_upload(void const *data, size_t size, AllocatedBuffer &target, VkDeviceSize target_offset = 0);
+	void queue_image_upload(void const *data, size_t size, AllocatedImage &target); //NOTE: image layout after upload is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; data is level 0 (other levels are generated)
+	// same as queue_image_upload, but returns the (mapped) staging memory for the caller to fill with the size bytes of level-0 data -- e.g., by decoding straight into it.
+	//  The pointer is valid until submit_uploads(), which must not be called before it is filled.
+	void *queue_image_upload_into(AllocatedImage &target, size_t size);
+	// uploads every mip level instead of generating them: data is all target.mip_levels levels packed tightly, level 0 first (see mip_level_size).
+	//  Needed for block-compressed formats, which can't be blitted.
+	void queue_image_levels_upload(void const *data, size_t size, AllocatedImage &target);
+	void *queue_image_levels_upload_into(AllocatedImage &target, size_t size);
+	// updates a rectangle of one mip level of an image that has already been uploaded (so is in SHADER_READ_ONLY layout), keeping the rest of its contents:
+	//  data is region.extent texels, tightly packed; the copy itself runs on the graphics queue (at acquisition, with a transfer queue), ordered with rendering that samples the image.
+	void queue_image_region_upload(void const *data, size_t size, AllocatedImage &target, VkRect2D const &region, uint32_t mip_level = 0);
+	UploadTicket submit_uploads(); //returns 0 if nothing was queued
+	bool upload_finished(UploadTicket ticket); //non-blocking; true once the copies are done
+	void wait_for_upload(UploadTicket ticket);
+
+	// Hands submitted uploads over to the graphics queue, oldest first:
+	//  records queue-family ownership "acquire" barriers into command_buffer and appends the semaphores (and stages) its submit must wait on.
+	//  Finished uploads are always taken; uploads up through `through` are taken even if unfinished (the submit will wait for them).
+	//  `submit_fence` is the fence command_buffer's submit signals (it tells Helpers when the semaphores can be reused).
+	// Without a dedicated transfer queue, this does nothing (uploads are already ordered before later graphics submits).
+	void acquire_uploads(VkCommandBuffer command_buffer, VkFence submit_fence, std::vector< VkSemaphore > *wait_semaphores, std::vector< VkPipelineStageFlags > *wait_stages, UploadTicket through = 0);
+	bool upload_acquired(UploadTicket ticket) const { return ticket <= AcquiredUploadTicket; }
+
+	VkCommandPool TransferCommandPool = VK_NULL_HANDLE; // on rtg.transfer_queue_family if there is one
+
+	struct UploadBatch
+	{
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Done = VK_NULL_HANDLE;
+		UploadTicket Ticket = 0;
+		std::vector< AllocatedBuffer > Staging; // staging buffers used by this batch (the last one is being filled)
+		VkDeviceSize StagingUsed = 0; // bytes used in Staging.back()
+		bool Finished = false; // Done has been seen signaled (Staging is returned to the pool then, unless RegionCopies read it later)
+
+		// ownership handoff from the transfer queue (unused without one):
+		VkSemaphore Ready = VK_NULL_HANDLE; // signaled by the upload submit, waited on by the acquiring submit
+		std::vector< VkBufferMemoryBarrier > BufferAcquires;
+		std::vector< VkImageMemoryBarrier > ImageAcquires;
+		std::vector< VkImageMemoryBarrier > MipAcquires; // images (all levels in TRANSFER_DST layout) whose mip chains are generated after acquisition
+		std::vector< VkExtent2D > MipExtents; // (level 0 size for each of MipAcquires)
+		struct RegionCopy
+		{
+			VkBuffer Staging = VK_NULL_HANDLE;
+			VkImage Image = VK_NULL_HANDLE;
+			VkBufferImageCopy Copy{};
+		};
+		std::vector< RegionCopy > RegionCopies; // recorded by acquire_uploads() on the graphics queue
+		bool GraphicsReadsStaging = false; // RegionCopies were recorded, so Staging lives until the acquiring submit is done
+		VkFence AcquiredBy = VK_NULL_HANDLE; // fence of the acquiring submit (Ready is reusable once it signals)
+	};
+	std::unique_ptr< UploadBatch > CurrentUpload; // being recorded (if any)
+	std::vector< std::unique_ptr< UploadBatch > > PendingUploads; // submitted, oldest first
+	std::vector< std::unique_ptr< UploadBatch > > FreeUploadBatches; // finished, ready for reuse
+	std::vector< AllocatedBuffer > StagingPool; // staging buffers not in use by any batch
+	UploadTicket NextUploadTicket = 1;
+	UploadTicket AcquiredUploadTicket = 0; // every batch up to this ticket has been acquired by the graphics queue
+	static constexpr VkDeviceSize StagingBufferSize = 16 * 1024 * 1024; // (bigger uploads get a staging buffer of their own)
+	static constexpr VkDeviceSize StagingPoolKeep = 64 * 1024 * 1024; // idle staging memory kept for reuse
+
+	// stages (and accesses) that may consume uploaded data on the graphics queue:
+	static constexpr VkPipelineStageFlags UploadConsumerStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	static constexpr VkAccessFlags UploadConsumerAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	UploadBatch &BeginUpload(); // CurrentUpload, started if needed
+	void *UploadStaging(size_t size, VkBuffer *buffer, VkDeviceSize *offset); // space in CurrentUpload's staging
+	void *QueueImageUpload(AllocatedImage &target, size_t size, uint32_t provided_levels); // levels past provided_levels (1 or all) are generated
+	void ReleaseUpload(VkBuffer target, VkDeviceSize offset, VkDeviceSize size); // end of a buffer copy in CurrentUpload (ownership release, if needed)
+	void ReleaseUpload(VkImage target, VkImageSubresourceRange const &range); // end of an image copy in CurrentUpload (layout -> shader read, plus ownership release if needed)
+	void RetireUploads(); // recycle batches whose fences (and acquiring submits' fences) have signaled
+	// copies part of one level of image (in SHADER_READ_ONLY layout; returned to it after) from staging:
+	void RecordRegionCopy(VkCommandBuffer command_buffer, VkBuffer staging, VkImage image, VkBufferImageCopy const &copy);
+	// staging buffers are read by both the transfer and graphics queues (if they differ), so they are created with concurrent sharing:
+	AllocatedBuffer CreateStagingBuffer(VkDeviceSize size);
+	// blits level 0 of image (all levels in TRANSFER_DST layout, level 0 written) down through the rest of its levels, leaving them all in SHADER_READ_ONLY layout:
+	// (blits need a graphics queue)
+	void RecordMipChain(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, uint32_t levels);
+
+	//-----------------------
+	//GPU -> CPU data transfer:
+
+	// Readbacks copy into host-visible (preferably host-cached) memory and return a ticket right away; nothing waits unless asked to.
+	using ReadbackTicket = uint64_t;
+	// each is its own graphics-queue submit, ordered after everything already submitted to the graphics queue:
+	ReadbackTicket readback_buffer(AllocatedBuffer const &source, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	ReadbackTicket readback_image(AllocatedImage const &source, VkImageLayout layout, uint32_t mip_level = 0); //layout is the image's current layout (it is restored after the copy)
+	// recorded into command_buffer instead (e.g., to capture a swapchain image before it is presented):
+	//  call submit_recorded_readbacks() right after command_buffer is submitted to the graphics queue; image needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+	ReadbackTicket record_image_readback(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout);
+	// gives each recorded readback not yet submitted its own fence, signaled (by an empty submit) once everything already on the graphics queue is done:
+	void submit_recorded_readbacks();
+	// if the readback has finished (or `wait` is set), moves its data into *data (image rows are tightly packed) and returns true:
+	bool take_readback(ReadbackTicket ticket, std::vector< uint8_t > *data, bool wait = false);
+
+	struct Readback
+	{
+		ReadbackTicket Ticket = 0;
+		AllocatedBuffer Buffer; // copy destination (mapped)
+		VkDeviceSize Size = 0; // bytes of data in Buffer
+		VkFence Done = VK_NULL_HANDLE; // ReadbackSubmits' fence, or one of FreeReadbackFences (null until a recorded readback is submitted)
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE; // (null if recorded into the caller's command buffer)
+	};
+	std::vector< Readback > Readbacks; // in flight or waiting to be taken
+	struct ReadbackSubmit
+	{
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Done = VK_NULL_HANDLE;
+	};
+	std::vector< ReadbackSubmit > FreeReadbackSubmits;
+	std::vector< VkFence > FreeReadbackFences; // (for recorded readbacks)
+	VkCommandPool ReadbackCommandPool = VK_NULL_HANDLE; // on the graphics queue family
+	ReadbackTicket NextReadbackTicket = 1;
+	VkDeviceSize NonCoherentAtomSize = 1; // (readback memory might not be coherent, so needs invalidating)
+
+	Readback &BeginReadback(VkDeviceSize size, bool own_submit); // adds to Readbacks (with a command buffer, already begun, if own_submit)
+	ReadbackTicket SubmitReadback(Readback &readback); // ends and submits an own_submit readback's command buffer
+	void RecordImageReadback(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, uint32_t mip_level, VkBuffer target);
 
 	//-----------------------
 	//Misc utilities:
 
 	// for selecting memory types (used by allocate, above):
 	VkPhysicalDeviceMemoryProperties MemoryProperties{};
-	uint32_t FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Flags) const;
+	// picks the allowed type with all Required flags that best matches Preferred flags (and has the fewest other flags); throws if there is none:
+	uint32_t FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred = 0) const;
+	// as above, but returns an empty optional if there is no such type:
+	std::optional< uint32_t > SelectMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Required, VkMemoryPropertyFlags Preferred = 0) const;
 
 	//for selecting image formats:
 	VkFormat find_image_format(std::vector< VkFormat > const &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
@@ -6,44 +6,274 @@
 #include <cstdint>
 #include <stdexcept>
 #include <cstring>
-
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <filesystem>
-namespace fs = std::filesystem;
+#include <cstdio>
+
+#include "MappedFile.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 
+// 8-bit RGBA pixels straight from stb_image (no extra copy), rows bottom-to-top:
+struct DecodedImage
+{
+    struct StbiFree
+    {
+        void operator()(unsigned char* pixels) const { stbi_image_free(pixels); }
+    };
+
+    std::string Path;
+    int Width = 1;
+    int Height = 1;
+    std::unique_ptr<unsigned char[], StbiFree> Pixels; // null if decoding failed (then the image is a single white texel)
+
+    void const* Data() const
+    {
+        static const uint32_t White = 0xFFFFFFFF;
+        return Pixels ? static_cast<void const*>(Pixels.get()) : static_cast<void const*>(&White);
+    }
+    size_t Size() const { return static_cast<size_t>(Width) * Height * 4; }
+};
+
+// Decoded texels from the on-disk texture cache, mapped straight from the file (see ImageLoader::CachePath):
+struct CachedImage
+{
+    // Layout of a cache file: this header, then Width x Height 8-bit RGBA texels, rows bottom-to-top (exactly what gets uploaded):
+    struct Header
+    {
+        char Magic[8];
+        uint32_t Width;
+        uint32_t Height;
+    };
+    static constexpr char Magic[8] = { 'R', 'T', 'G', 'T', 'E', 'X', 'C', '1' };
+
+    MappedFile File;
+    int Width = 0;
+    int Height = 0;
+
+    void const* Data() const { return File.data() + sizeof(Header); }
+    size_t Size() const { return static_cast<size_t>(Width) * Height * 4; }
+};
+
 class ImageLoader
 {
 public:
     ImageLoader() = delete;
-    static std::vector<uint32_t> Load(const std::string& relativePath, int& outWidth, int& outHeight)
+
+    static DecodedImage Load(const std::string& relativePath)
     {
-        stbi_set_flip_vertically_on_load(true);
-        std::cout << "Current path: " << fs::current_path() << std::endl;
+        // (per-thread setting, so decodes on other threads aren't affected)
+        stbi_set_flip_vertically_on_load_thread(true);
 
-        int channels = 0;
+        DecodedImage image;
+        image.Path = relativePath;
+
+        int width = 0, height = 0, channels = 0;
         unsigned char* pixels = stbi_load
         (
             relativePath.c_str(),
-            &outWidth,
-            &outHeight,
+            &width,
+            &height,
             &channels,
             STBI_rgb_alpha
         );
 
         if (!pixels)
+        {
+            std::cerr << "Failed to load '" + relativePath + "' (" + stbi_failure_reason() + "); using a white texel instead.\n";
+            return image;
+        }
+
+        image.Width = width;
+        image.Height = height;
+        image.Pixels.reset(pixels);
+        return image;
+    }
+
+    // Decodes every file on a pool of worker threads (threadCount = 0 means one per core); results are in the same order as paths:
+    static std::vector<DecodedImage> LoadBatch(std::vector<std::string> const& paths, unsigned threadCount = 0)
+    {
+        std::vector<DecodedImage> images(paths.size());
+        ParallelFor(paths.size(), threadCount, [&](size_t i)
+        {
+            images[i] = Load(paths[i]);
+        });
+        return images;
+    }
+
+    // Size of an image file, from its header alone (much faster than decoding it); a file that can't be read is reported as 1x1 (see DecodeInto):
+    static void Info(const std::string& relativePath, int& outWidth, int& outHeight)
+    {
+        int channels = 0;
+        if (!stbi_info(relativePath.c_str(), &outWidth, &outHeight, &channels))
         {
             outWidth = 1;
             outHeight = 1;
-            return std::vector<uint32_t>{ 0xFFFFFFFF };
         }
+    }
+
+    // Where DecodeInto should put an image: Width x Height 8-bit RGBA texels (as from Info), rows bottom-to-top:
+    struct DecodeTarget
+    {
+        std::string Path;
+        int Width = 1;
+        int Height = 1;
+        void* Destination = nullptr; // e.g., mapped staging memory
+        std::string CachePath; // if non-empty, the decoded texels are also saved here (see CachePath)
+    };
+
+    // Decodes every file on a pool of worker threads straight into its target.
+    // The vertical flip happens while rows are copied out of stb_image's buffer (which is freed right away), so each texel is copied once:
+    static void DecodeInto(std::vector<DecodeTarget> const& targets, unsigned threadCount = 0)
+    {
+        ParallelFor(targets.size(), threadCount, [&](size_t i)
+        {
+            DecodeTarget const& target = targets[i];
+            size_t rowBytes = static_cast<size_t>(target.Width) * 4;
+            unsigned char* destination = static_cast<unsigned char*>(target.Destination);
+
+            stbi_set_flip_vertically_on_load_thread(false);
+            int width = 0, height = 0, channels = 0;
+            std::unique_ptr<unsigned char[], DecodedImage::StbiFree> pixels(stbi_load(target.Path.c_str(), &width, &height, &channels, STBI_rgb_alpha));
+
+            if (!pixels || width != target.Width || height != target.Height)
+            {
+                std::cerr << "Failed to load '" + target.Path + "' (" + (pixels ? "size changed since Info" : stbi_failure_reason()) + "); using white instead.\n";
+                std::memset(destination, 0xFF, rowBytes * target.Height);
+                return;
+            }
+
+            for (int row = 0; row < height; ++row)
+            {
+                std::memcpy(destination + rowBytes * (height - 1 - row), pixels.get() + rowBytes * row, rowBytes);
+            }
 
-        std::vector<uint32_t> data(static_cast<size_t>(outWidth) * outHeight);
-        std::memcpy(data.data(), pixels, data.size() * sizeof(uint32_t));
-        stbi_image_free(pixels);
-        return data;
+            if (!target.CachePath.empty())
+            {
+                SaveCached(target.CachePath, width, height, pixels.get());
+            }
+        });
+    }
+
+    // Where the decoded texels of a file live in the texture cache: named for a hash (FNV-1a) of the file's contents plus everything that affects decoding.
+    // Returns "" if the file can't be read (so there is nothing to cache).
+    static std::string CachePath(const std::string& cacheDirectory, const std::string& relativePath)
+    {
+        MappedFile source;
+        if (!source.open(relativePath)) return "";
+
+        // (bump the version whenever the decoded layout or stb_image's output could change)
+        static constexpr char Options[] = "rgba8;rows-bottom-to-top;v1";
+        uint64_t key = Fnv1a(source.data(), source.size());
+        key = Fnv1a(Options, sizeof(Options), key);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.rgba", static_cast<unsigned long long>(key));
+        return (std::filesystem::path(cacheDirectory) / name).string();
+    }
+
+    // Maps a cache file written by DecodeInto; returns false if there is none (or it is damaged):
+    static bool LoadCached(const std::string& cachePath, CachedImage& outImage)
+    {
+        if (!outImage.File.open(cachePath)) return false;
+
+        CachedImage::Header header;
+        if (outImage.File.size() >= sizeof(header))
+        {
+            std::memcpy(&header, outImage.File.data(), sizeof(header));
+            size_t expected = sizeof(header) + static_cast<size_t>(header.Width) * header.Height * 4;
+            if (std::memcmp(header.Magic, CachedImage::Magic, sizeof(header.Magic)) == 0 && header.Width > 0 && header.Height > 0 && outImage.File.size() == expected)
+            {
+                outImage.Width = static_cast<int>(header.Width);
+                outImage.Height = static_cast<int>(header.Height);
+                return true;
+            }
+        }
+
+        std::cerr << "Ignoring damaged texture cache file '" + cachePath + "'.\n";
+        outImage.File.close();
+        return false;
+    }
+
+private:
+    static uint64_t Fnv1a(void const* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        unsigned char const* bytes = static_cast<unsigned char const*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // writes a cache file from stb_image's (top-to-bottom) rows; written under a temporary name and renamed, so a partial file is never mapped:
+    static void SaveCached(const std::string& cachePath, int width, int height, unsigned char const* pixels)
+    {
+        std::string temporary = cachePath + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            CachedImage::Header header;
+            std::memcpy(header.Magic, CachedImage::Magic, sizeof(header.Magic));
+            header.Width = static_cast<uint32_t>(width);
+            header.Height = static_cast<uint32_t>(height);
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+            size_t rowBytes = static_cast<size_t>(width) * 4;
+            for (int row = height - 1; row >= 0; --row)
+            {
+                out.write(reinterpret_cast<char const*>(pixels + rowBytes * row), static_cast<std::streamsize>(rowBytes));
+            }
+            if (!out)
+            {
+                std::cerr << "Failed to write texture cache file '" + temporary + "'.\n";
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, cachePath, error);
+        if (error)
+        {
+            std::cerr << "Failed to write texture cache file '" + cachePath + "' (" + error.message() + ").\n";
+            std::filesystem::remove(temporary, error);
+        }
+    }
+
+    // calls fn(0) .. fn(count-1) from a pool of threadCount threads (0 means one per core), including the calling thread:
+    template <typename Fn>
+    static void ParallelFor(size_t count, unsigned threadCount, Fn const& fn)
+    {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::min<unsigned>(threadCount, static_cast<unsigned>(count));
+
+        // workers pull the next unstarted item until there are none left (so big and small files balance out):
+        std::atomic<size_t> next{ 0 };
+        auto work = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                fn(i);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount);
+        for (unsigned t = 1; t < threadCount; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        work(); // (the calling thread helps, too)
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
     }
-};
\ No newline at end of file
+};
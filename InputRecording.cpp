@@ -0,0 +1,138 @@
+#include "InputRecording.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little, "input recordings are stored little-endian.");
+
+static constexpr std::array< char, 8 > Magic{ 'R', 'T', 'G', 'I', 'N', 'P', 'U', 'T' };
+static constexpr uint32_t Version = 1;
+
+//helpers for writing/reading plain values:
+template< typename T >
+static void put(std::ofstream &out, T const &value) {
+	out.write(reinterpret_cast< char const * >(&value), sizeof(value));
+}
+
+template< typename T >
+static bool get(std::ifstream &in, T *value) {
+	in.read(reinterpret_cast< char * >(value), sizeof(*value));
+	return bool(in);
+}
+
+InputRecorder::InputRecorder(std::string const &path_) : path(path_) {
+	out.open(path, std::ios::binary | std::ios::trunc);
+	if (!out) throw std::runtime_error("Failed to open '" + path + "' to record input.");
+	out.write(Magic.data(), Magic.size());
+	put(out, Version);
+}
+
+InputRecorder::~InputRecorder() {
+	out.flush();
+	if (!out) {
+		std::cerr << "Error writing input recording '" << path << "'." << std::endl;
+	} else {
+		std::cout << "Recorded " << recorded << " input events to '" << path << "'." << std::endl;
+	}
+}
+
+void InputRecorder::record(uint64_t frame, InputEvent const &evt) {
+	if (frame > UINT32_MAX) return; //(would take well over a year at 60fps)
+	float seconds = std::chrono::duration< float >(std::chrono::steady_clock::now() - start).count();
+
+	put(out, uint32_t(frame));
+	put(out, seconds);
+	put(out, uint8_t(evt.type));
+	switch (evt.type) {
+		case InputEvent::MouseMotion:
+			put(out, evt.motion.x);
+			put(out, evt.motion.y);
+			put(out, evt.motion.state);
+			break;
+		case InputEvent::MouseButtonDown:
+		case InputEvent::MouseButtonUp:
+			put(out, evt.button.x);
+			put(out, evt.button.y);
+			put(out, evt.button.state);
+			put(out, evt.button.button);
+			put(out, evt.button.mods);
+			break;
+		case InputEvent::MouseWheel:
+			put(out, evt.wheel.x);
+			put(out, evt.wheel.y);
+			break;
+		case InputEvent::KeyDown:
+		case InputEvent::KeyUp:
+			put(out, int32_t(evt.key.key));
+			put(out, int32_t(evt.key.mods));
+			break;
+	}
+	recorded += 1;
+}
+
+InputReplay::InputReplay(std::string const &path_) : path(path_) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) throw std::runtime_error("Failed to open input recording '" + path + "'.");
+
+	std::array< char, 8 > magic;
+	uint32_t version = 0;
+	if (!in.read(magic.data(), magic.size()) || magic != Magic) {
+		throw std::runtime_error("'" + path + "' is not an input recording.");
+	}
+	if (!get(in, &version) || version != Version) {
+		throw std::runtime_error("Input recording '" + path + "' has version " + std::to_string(version) + ", expected " + std::to_string(Version) + ".");
+	}
+
+	while (true) {
+		Record record;
+		std::memset(&record.event, 0, sizeof(record.event));
+		if (!get(in, &record.frame)) break; //clean end of file
+
+		uint8_t type = 0;
+		bool ok = get(in, &record.seconds) && get(in, &type);
+		if (ok) {
+			record.event.type = InputEvent::Type(type);
+			switch (record.event.type) {
+				case InputEvent::MouseMotion:
+					ok = get(in, &record.event.motion.x)
+					  && get(in, &record.event.motion.y)
+					  && get(in, &record.event.motion.state);
+					break;
+				case InputEvent::MouseButtonDown:
+				case InputEvent::MouseButtonUp:
+					ok = get(in, &record.event.button.x)
+					  && get(in, &record.event.button.y)
+					  && get(in, &record.event.button.state)
+					  && get(in, &record.event.button.button)
+					  && get(in, &record.event.button.mods);
+					break;
+				case InputEvent::MouseWheel:
+					ok = get(in, &record.event.wheel.x)
+					  && get(in, &record.event.wheel.y);
+					break;
+				case InputEvent::KeyDown:
+				case InputEvent::KeyUp: {
+					int32_t key = 0, mods = 0;
+					ok = get(in, &key) && get(in, &mods);
+					record.event.key.key = key;
+					record.event.key.mods = mods;
+					break;
+				}
+				default:
+					throw std::runtime_error("Input recording '" + path + "' has unknown event type " + std::to_string(type) + " in record " + std::to_string(records.size()) + ".");
+			}
+		}
+		if (!ok) throw std::runtime_error("Input recording '" + path + "' is truncated in record " + std::to_string(records.size()) + ".");
+		if (!records.empty() && record.frame < records.back().frame) {
+			throw std::runtime_error("Input recording '" + path + "' has out-of-order frames in record " + std::to_string(records.size()) + ".");
+		}
+		records.emplace_back(record);
+	}
+
+	std::cout << "Loaded " << records.size() << " input events from '" << path << "'";
+	if (!records.empty()) std::cout << " spanning " << (records.back().frame + 1) << " frames";
+	std::cout << "." << std::endl;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+//Recording and replay of InputEvents, so interactive sessions can be reproduced exactly.
+//
+//File format (all values little-endian):
+//  header: "RTGINPUT" magic, uint32_t version
+//  records: uint32_t frame, float seconds, uint8_t type, then a type-dependent payload:
+//    MouseMotion:              float x, float y, uint8_t state
+//    MouseButtonDown/Up:       float x, float y, uint8_t state, uint8_t button, uint8_t mods
+//    MouseWheel:               float x, float y
+//    KeyDown/Up:               int32_t key, int32_t mods
+
+#include "InputEvent.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct InputRecorder {
+	//opens (and truncates) `path`, writing the file header; throws on error:
+	InputRecorder(std::string const &path);
+	InputRecorder(InputRecorder const &) = delete;
+	~InputRecorder();
+
+	//append an event, tagged with the number of frames updated before it arrived:
+	void record(uint64_t frame, InputEvent const &evt);
+
+	std::string path;
+	uint64_t recorded = 0; //events written so far
+
+private:
+	std::ofstream out;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+struct InputReplay {
+	struct Record {
+		uint32_t frame; //number of frames updated before the event arrived
+		float seconds; //time since recording started (informational)
+		InputEvent event;
+	};
+
+	//loads all records from `path`; throws on error:
+	InputReplay(std::string const &path);
+
+	//pass every event recorded before `frame` was updated to `callback`, in order:
+	template< typename F >
+	void play(uint64_t frame, F const &callback) {
+		while (next < records.size() && records[next].frame <= frame) {
+			callback(records[next].event);
+			++next;
+		}
+	}
+
+	bool finished() const { return next >= records.size(); }
+
+	std::string path;
+	std::vector< Record > records;
+	size_t next = 0; //index of the next record to play
+};
@@ -0,0 +1,229 @@
+#include "KTX2.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little, "KTX2 files are stored little-endian.");
+
+static constexpr std::array< uint8_t, 12 > Identifier{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+//what the data format descriptor says about each supported format:
+struct KTX2Format {
+	VkFormat format;
+	uint32_t block_size; //bytes per 4x4 block
+	uint8_t color_model; //KHR_DF_MODEL_*
+	uint8_t transfer; //KHR_DF_TRANSFER_*: 1 = linear, 2 = sRGB
+	uint8_t channel; //KHR_DF_CHANNEL_* of the (single) sample
+};
+static constexpr std::array< KTX2Format, 5 > Formats{{
+	{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, 128 /*BC1A*/, 1, 0 /*COLOR*/ },
+	{ VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, 128 /*BC1A*/, 2, 0 /*COLOR*/ },
+	{ VK_FORMAT_BC4_UNORM_BLOCK, 8, 131 /*BC4*/, 1, 0 /*DATA*/ },
+	{ VK_FORMAT_BC7_UNORM_BLOCK, 16, 134 /*BC7*/, 1, 0 /*COLOR*/ },
+	{ VK_FORMAT_BC7_SRGB_BLOCK, 16, 134 /*BC7*/, 2, 0 /*COLOR*/ },
+}};
+
+static KTX2Format const *find_format(VkFormat format) {
+	for (KTX2Format const &info : Formats) {
+		if (info.format == format) return &info;
+	}
+	return nullptr;
+}
+
+//helpers for writing/reading plain values:
+template< typename T >
+static void put(std::vector< uint8_t > &out, T const &value) {
+	uint8_t const *bytes = reinterpret_cast< uint8_t const * >(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+template< typename T >
+static T get(uint8_t const *at) {
+	T value;
+	std::memcpy(&value, at, sizeof(value));
+	return value;
+}
+
+static void pad_to(std::vector< uint8_t > &out, size_t alignment) {
+	out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+bool KTX2Texture::supported(VkFormat format) {
+	return find_format(format) != nullptr;
+}
+
+size_t KTX2Texture::level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+	KTX2Format const *info = find_format(format);
+	if (!info) throw std::runtime_error("KTX2: unsupported format " + std::to_string(int(format)) + ".");
+	size_t blocks_x = (std::max(width >> level, 1u) + 3) / 4;
+	size_t blocks_y = (std::max(height >> level, 1u) + 3) / 4;
+	return blocks_x * blocks_y * info->block_size;
+}
+
+KTX2Texture::KTX2Texture(std::string const &path_) : path(path_) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) throw std::runtime_error("Failed to open KTX2 file '" + path + "'.");
+
+	//identifier, header, and index (80 bytes), then the level index:
+	std::array< uint8_t, 80 > header;
+	if (!in.read(reinterpret_cast< char * >(header.data()), header.size())) {
+		throw std::runtime_error("KTX2 file '" + path + "' is truncated.");
+	}
+	if (!std::equal(Identifier.begin(), Identifier.end(), header.begin())) {
+		throw std::runtime_error("'" + path + "' is not a KTX2 file.");
+	}
+
+	format = VkFormat(get< uint32_t >(&header[12]));
+	width = get< uint32_t >(&header[20]);
+	height = get< uint32_t >(&header[24]);
+	uint32_t depth = get< uint32_t >(&header[28]);
+	uint32_t layer_count = get< uint32_t >(&header[32]);
+	uint32_t face_count = get< uint32_t >(&header[36]);
+	uint32_t level_count = get< uint32_t >(&header[40]);
+	uint32_t supercompression = get< uint32_t >(&header[44]);
+
+	if (!supported(format)) {
+		throw std::runtime_error("KTX2 file '" + path + "' has unsupported format " + std::to_string(int(format)) + ".");
+	}
+	if (width == 0 || height == 0 || depth != 0 || layer_count > 1 || face_count != 1 || supercompression != 0) {
+		throw std::runtime_error("KTX2 file '" + path + "' is not a plain 2D texture.");
+	}
+	if (level_count == 0 || level_count > 32) {
+		throw std::runtime_error("KTX2 file '" + path + "' has no stored mip levels.");
+	}
+
+	std::vector< uint8_t > index(level_count * 24);
+	if (!in.read(reinterpret_cast< char * >(index.data()), index.size())) {
+		throw std::runtime_error("KTX2 file '" + path + "' is truncated.");
+	}
+	levels.reserve(level_count);
+	for (uint32_t level = 0; level < level_count; ++level) {
+		Level stored{
+			.offset = get< uint64_t >(&index[level * 24 + 0]),
+			.size = get< uint64_t >(&index[level * 24 + 8]),
+		};
+		if (stored.size != level_size(format, width, height, level)) {
+			throw std::runtime_error("KTX2 file '" + path + "' has level " + std::to_string(level) + " of the wrong size.");
+		}
+		levels.emplace_back(stored);
+	}
+}
+
+size_t KTX2Texture::levels_size(uint32_t count) const {
+	size_t total = 0;
+	for (uint32_t level = 0; level < count; ++level) {
+		total += size_t(levels.at(level).size);
+	}
+	return total;
+}
+
+void KTX2Texture::read_levels(uint32_t count, void *dst) const {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) throw std::runtime_error("Failed to open KTX2 file '" + path + "'.");
+
+	char *at = reinterpret_cast< char * >(dst);
+	for (uint32_t level = 0; level < count; ++level) {
+		Level const &stored = levels.at(level);
+		in.seekg(std::streamoff(stored.offset));
+		if (!in.read(at, std::streamsize(stored.size))) {
+			throw std::runtime_error("KTX2 file '" + path + "' is truncated (level " + std::to_string(level) + ").");
+		}
+		at += stored.size;
+	}
+}
+
+void KTX2Texture::write(std::string const &path, VkFormat format, uint32_t width, uint32_t height, std::vector< std::vector< uint8_t > > const &levels) {
+	KTX2Format const *info = find_format(format);
+	if (!info) throw std::runtime_error("KTX2: unsupported format " + std::to_string(int(format)) + ".");
+	if (levels.empty()) throw std::runtime_error("KTX2: no levels to write.");
+	for (uint32_t level = 0; level < levels.size(); ++level) {
+		if (levels[level].size() != level_size(format, width, height, level)) {
+			throw std::runtime_error("KTX2: level " + std::to_string(level) + " is the wrong size.");
+		}
+	}
+
+	//data format descriptor: one basic block with a single sample covering the whole compressed block:
+	std::vector< uint8_t > dfd;
+	{
+		uint32_t block_bytes = 24 + 16;
+		put(dfd, uint32_t(4 + block_bytes)); //dfdTotalSize
+		put(dfd, uint32_t(0)); //vendorId = KHRONOS, descriptorType = BASICFORMAT
+		put(dfd, uint32_t(2 | (block_bytes << 16))); //versionNumber, descriptorBlockSize
+		put(dfd, info->color_model);
+		put(dfd, uint8_t(1)); //colorPrimaries = BT709
+		put(dfd, info->transfer);
+		put(dfd, uint8_t(0)); //flags = straight alpha
+		put(dfd, std::array< uint8_t, 4 >{ 3, 3, 0, 0 }); //texelBlockDimension (minus one)
+		put(dfd, std::array< uint8_t, 8 >{ uint8_t(info->block_size), 0, 0, 0, 0, 0, 0, 0 }); //bytesPlane
+		put(dfd, uint16_t(0)); //bitOffset
+		put(dfd, uint8_t(info->block_size * 8 - 1)); //bitLength (minus one)
+		put(dfd, info->channel); //channelType
+		put(dfd, uint32_t(0)); //samplePosition
+		put(dfd, uint32_t(0)); //sampleLower
+		put(dfd, uint32_t(0xffffffff)); //sampleUpper
+	}
+
+	//key/value data:
+	std::vector< uint8_t > kvd;
+	auto put_key_value = [&](std::string const &key, std::string const &value) {
+		put(kvd, uint32_t(key.size() + 1 + value.size() + 1));
+		kvd.insert(kvd.end(), key.begin(), key.end());
+		kvd.emplace_back(0);
+		kvd.insert(kvd.end(), value.begin(), value.end());
+		kvd.emplace_back(0);
+		pad_to(kvd, 4);
+	};
+	put_key_value("KTXorientation", "ru");
+	put_key_value("KTXwriter", "TextureCompressor");
+
+	//layout: header + index, level index, dfd, kvd, then levels (smallest first, each aligned to the block size):
+	size_t dfd_offset = 80 + levels.size() * 24;
+	size_t kvd_offset = dfd_offset + dfd.size();
+	size_t data_offset = kvd_offset + kvd.size();
+
+	std::vector< uint64_t > level_offsets(levels.size());
+	size_t end = data_offset;
+	for (size_t level = levels.size(); level-- > 0; ) {
+		end = (end + info->block_size - 1) / info->block_size * info->block_size;
+		level_offsets[level] = end;
+		end += levels[level].size();
+	}
+
+	std::vector< uint8_t > out;
+	out.reserve(end);
+	out.insert(out.end(), Identifier.begin(), Identifier.end());
+	put(out, uint32_t(format));
+	put(out, uint32_t(1)); //typeSize (1 for block-compressed formats)
+	put(out, width);
+	put(out, height);
+	put(out, uint32_t(0)); //pixelDepth
+	put(out, uint32_t(0)); //layerCount
+	put(out, uint32_t(1)); //faceCount
+	put(out, uint32_t(levels.size()));
+	put(out, uint32_t(0)); //supercompressionScheme
+	put(out, uint32_t(dfd_offset));
+	put(out, uint32_t(dfd.size()));
+	put(out, uint32_t(kvd_offset));
+	put(out, uint32_t(kvd.size()));
+	put(out, uint64_t(0)); //sgdByteOffset
+	put(out, uint64_t(0)); //sgdByteLength
+	for (size_t level = 0; level < levels.size(); ++level) {
+		put(out, level_offsets[level]);
+		put(out, uint64_t(levels[level].size())); //byteLength
+		put(out, uint64_t(levels[level].size())); //uncompressedByteLength
+	}
+	out.insert(out.end(), dfd.begin(), dfd.end());
+	out.insert(out.end(), kvd.begin(), kvd.end());
+	for (size_t level = levels.size(); level-- > 0; ) {
+		out.resize(level_offsets[level], 0);
+		out.insert(out.end(), levels[level].begin(), levels[level].end());
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast< char const * >(out.data()), out.size());
+	if (!file) throw std::runtime_error("Failed to write KTX2 file '" + path + "'.");
+}
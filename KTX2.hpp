@@ -0,0 +1,42 @@
+#pragma once
+
+//Reading and writing KTX2 (Khronos Texture 2.0) files holding block-compressed images and their mip chains.
+//
+//Only what TextureCompressor writes is supported: a single 2D image (no array layers, cube faces, or
+// supercompression) in one of the BCn formats listed in KTX2.cpp.
+//Rows are stored bottom-to-top (KTXorientation "ru"), matching what ImageLoader hands to the GPU.
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct KTX2Texture {
+	//reads the header and level index of `path` (level data is read by read_levels); throws on error:
+	KTX2Texture(std::string const &path);
+
+	//reads levels [0, count) into `dst`, packed tightly, level 0 first; throws on error:
+	void read_levels(uint32_t count, void *dst) const;
+	//bytes read_levels(count, ...) writes:
+	size_t levels_size(uint32_t count) const;
+
+	//writes a texture; `levels` are level 0 first, each exactly level_size() bytes; throws on error:
+	static void write(std::string const &path, VkFormat format, uint32_t width, uint32_t height, std::vector< std::vector< uint8_t > > const &levels);
+
+	//is `format` one of the (block-compressed) formats handled here?
+	static bool supported(VkFormat format);
+	//bytes in one mip level of a supported format (whole 4x4 blocks):
+	static size_t level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+
+	std::string path;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	struct Level {
+		uint64_t offset; //in the file
+		uint64_t size;
+	};
+	std::vector< Level > levels; //level 0 first
+};
@@ -26,12 +26,19 @@ custom_flags_and_rules();
 
 //maek.CPP(...) builds a c++ file:
 // it returns the path to the output object file
+const ktx2_obj = maek.CPP('KTX2.cpp'); //(shared by main and the texture compressor)
 const main_objs = [
 	maek.CPP('Tutorial.cpp'),
 	maek.CPP('PosColVertex.cpp'),
 	maek.CPP('PosNorTexVertex.cpp'),
 	maek.CPP('RTG.cpp'),
 	maek.CPP('Helpers.cpp'),
+	maek.CPP('FrameTiming.cpp'),
+	maek.CPP('InputRecording.cpp'),
+	maek.CPP('MappedFile.cpp'),
+	maek.CPP('FrustumCull.cpp'),
+	maek.CPP('MeshOptimizer.cpp'),
+	ktx2_obj,
 	maek.CPP('main.cpp'),
 ];
 
@@ -56,9 +63,16 @@ main_objs.push( maek.CPP('Tutorial-LinesPipeline.cpp', undefined, { depends:[...
 const objects_shaders = [
 	maek.GLSLC('objects.vert'),
 	maek.GLSLC('objects.frag'),
+	maek.GLSLC('objects-fallback.frag'), //(without descriptor indexing)
 ];
 main_objs.push( maek.CPP('Tutorial-ObjectsPipeline.cpp', undefined, { depends:[...objects_shaders] } ) );
 
+//frustum culling compute shader and pipeline:
+const cull_shaders = [
+	maek.GLSLC('cull.comp'),
+];
+main_objs.push( maek.CPP('Tutorial-CullPipeline.cpp', undefined, { depends:[...cull_shaders] } ) );
+
 const prebuilt_objs = [ ];
 
 //use the prebuilt refsol.o unless refsol.cpp exists:
@@ -74,8 +88,21 @@ if (require('fs').existsSync('refsol.cpp')) {
 
 const main_exe = maek.LINK([...main_objs, ...prebuilt_objs], 'bin/main');
 
+//offline texture compressor (image -> block-compressed KTX2 with mips):
+const texture_compressor_exe = maek.LINK([
+	maek.CPP('TextureCompressor.cpp'),
+	maek.CPP('BCEncoder.cpp'),
+	ktx2_obj,
+], 'bin/texture-compressor', { LINKLibs:[] }); //(needs neither Vulkan nor GLFW at runtime)
+
+//maek.KTX2(...) compresses a texture; Tutorial loads the .ktx2 (when the device supports BC formats) instead of the original:
+const compressed_textures = [
+	maek.KTX2('Textures/YellowPaint.jpg', undefined, { KTX2Flags:['--bc1'] }), //opaque color
+	maek.KTX2('Textures/WaterMask.png', undefined, { KTX2Flags:['--bc7', '--srgb'] }),
+];
+
 //default targets:
-maek.TARGETS = [main_exe];
+maek.TARGETS = [main_exe, ...compressed_textures];
 
 //- - - - - - - - - - - - - - - - - - - - -
 function custom_flags_and_rules() {
@@ -104,6 +131,7 @@ function custom_flags_and_rules() {
 			`-L${GLFW_DIR}/lib`,
 			'-lX11',
 			`-lglfw3`,
+			'-pthread', //for ImageLoader's decode threads
 		];
 
 	} else if (maek.OS === 'windows') {
@@ -219,6 +247,52 @@ function custom_flags_and_rules() {
 
 		return spirvFile;
 	};
+
+	//- - - - - - - - - - - - -
+	//custom rule that runs the texture compressor:
+
+	maek.DEFAULT_OPTIONS.KTX2Compressor = 'bin/texture-compressor' + maek.DEFAULT_OPTIONS.exeSuffix;
+	maek.DEFAULT_OPTIONS.KTX2Flags = [];
+
+	//maek.KTX2 is a rule to compress an image into a .ktx2 file:
+	// imageFile is the source image
+	// ktx2FileBase (optional) is the output file (including any subdirectories, but not the extension); defaults to imageFile without its extension
+	maek.KTX2 = (imageFile, ktx2FileBase, localOptions = {}) => {
+		const path = require('path').posix; //NOTE: expect posix-style paths even on windows
+
+		//combine options:
+		const options = maek.combineOptions(localOptions);
+
+		if (typeof ktx2FileBase === 'undefined') {
+			ktx2FileBase = imageFile.substr(0, imageFile.length - path.extname(imageFile).length);
+		}
+		const ktx2File = ktx2FileBase + '.ktx2';
+
+		//(absolute path to the compressor, since maek.run looks up relative commands in PATH)
+		const command = [require('path').resolve(options.KTX2Compressor), ...options.KTX2Flags, imageFile, ktx2File];
+
+		const task = async () => {
+			await maek.run(command, `${task.label}: compress`,
+				async () => {
+					return {
+						read:[imageFile],
+						written:[ktx2File]
+					};
+				}
+			);
+		};
+
+		task.depends = [imageFile, options.KTX2Compressor, ...options.depends];
+
+		task.label = `KTX2 ${ktx2File}`;
+
+		if (ktx2File in maek.tasks) {
+			throw new Error(`Task ${task.label} purports to create ${ktx2File}, but ${maek.tasks[ktx2File].label} already creates that file.`);
+		}
+		maek.tasks[ktx2File] = task;
+
+		return ktx2File;
+	};
 }
 
 //======================================================================
@@ -0,0 +1,93 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) {
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+	if (this != &other) {
+		close();
+		std::swap(view, other.view);
+		std::swap(length, other.length);
+		std::swap(mapping, other.mapping);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(std::string const &path) {
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER file_size{};
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) {
+			view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view) {
+				length = size_t(file_size.QuadPart);
+			} else {
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+		}
+	}
+	CloseHandle(file); //(the mapping keeps the file open)
+	return view != nullptr;
+}
+
+void MappedFile::close() {
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	view = nullptr;
+	mapping = nullptr;
+	length = 0;
+}
+
+#else
+
+bool MappedFile::open(std::string const &path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info{};
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void *mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED) {
+			view = mapped;
+			length = size_t(info.st_size);
+		}
+	}
+	::close(fd); //(the mapping keeps the file open)
+	return view != nullptr;
+}
+
+void MappedFile::close() {
+	if (view) munmap(const_cast< void * >(view), length);
+	view = nullptr;
+	length = 0;
+}
+
+#endif
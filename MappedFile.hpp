@@ -0,0 +1,29 @@
+#pragma once
+
+//Read-only memory mapping of a whole file (mmap on POSIX, a file mapping on Windows).
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct MappedFile {
+	MappedFile() = default;
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+	~MappedFile();
+
+	//maps all of `path`, replacing any current mapping; returns false (leaving this empty) if it doesn't exist, is empty, or can't be mapped:
+	bool open(std::string const &path);
+	void close();
+
+	uint8_t const *data() const { return reinterpret_cast< uint8_t const * >(view); }
+	size_t size() const { return length; }
+	explicit operator bool() const { return view != nullptr; }
+
+private:
+	void const *view = nullptr;
+	size_t length = 0;
+	void *mapping = nullptr; //(Windows only: the file mapping object's handle)
+};
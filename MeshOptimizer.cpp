@@ -0,0 +1,150 @@
+#include "MeshOptimizer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+//FNV-1a of a vertex's bytes:
+static uint64_t hash_bytes(uint8_t const *bytes, size_t size) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+std::vector< uint32_t > weld_vertices(void const *vertices_, size_t count, size_t stride, size_t *unique_count) {
+	assert(unique_count);
+	uint8_t const *vertices = reinterpret_cast< uint8_t const * >(vertices_);
+
+	//open-addressed table of (original) indices of unique vertices, at most half full:
+	size_t table_size = 1;
+	while (table_size < 2 * count) table_size *= 2;
+	std::vector< uint32_t > table(table_size, ~0u);
+
+	std::vector< uint32_t > remap(count);
+	*unique_count = 0;
+	for (size_t i = 0; i < count; ++i) {
+		uint8_t const *vertex = vertices + i * stride;
+		size_t slot = size_t(hash_bytes(vertex, stride)) & (table_size - 1);
+		while (table[slot] != ~0u && std::memcmp(vertices + size_t(table[slot]) * stride, vertex, stride) != 0) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] == ~0u) {
+			table[slot] = uint32_t(i);
+			remap[i] = uint32_t(*unique_count);
+			*unique_count += 1;
+		} else {
+			remap[i] = remap[table[slot]];
+		}
+	}
+	return remap;
+}
+
+std::vector< uint32_t > tipsify(std::vector< uint32_t > const &indices, size_t vertex_count, uint32_t cache_size) {
+	assert(indices.size() % 3 == 0);
+	size_t triangle_count = indices.size() / 3;
+
+	//triangles using each vertex (compressed: vertex v's are adjacency[offsets[v]] up to adjacency[offsets[v+1]]):
+	std::vector< uint32_t > live(vertex_count, 0); //triangles not yet emitted that use each vertex
+	for (uint32_t v : indices) live[v] += 1;
+	std::vector< uint32_t > offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v) offsets[v + 1] = offsets[v] + live[v];
+	std::vector< uint32_t > adjacency(indices.size());
+	{
+		std::vector< uint32_t > fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	std::vector< uint32_t > cache_time(vertex_count, 0); //time each vertex last entered the (simulated) cache
+	std::vector< bool > emitted(triangle_count, false);
+	std::vector< uint32_t > dead_end; //recently used vertices, to restart from when fanning runs out of neighbors
+	std::vector< uint32_t > candidates;
+
+	std::vector< uint32_t > out;
+	out.reserve(indices.size());
+
+	uint32_t time = cache_size + 1;
+	size_t cursor = 0; //input order position for when dead_end is exhausted too
+	int64_t fan = (vertex_count > 0 ? 0 : -1);
+
+	while (fan >= 0) {
+		//emit every remaining triangle around the fanning vertex:
+		candidates.clear();
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t]) continue;
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t v = indices[3 * t + c];
+				out.emplace_back(v);
+				dead_end.emplace_back(v);
+				candidates.emplace_back(v);
+				live[v] -= 1;
+				if (time - cache_time[v] > cache_size) {
+					cache_time[v] = time;
+					time += 1;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		//next fanning vertex: the candidate that will still be in the cache after its remaining triangles are emitted, oldest first:
+		fan = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) continue;
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+			if (priority > best) {
+				best = priority;
+				fan = v;
+			}
+		}
+
+		//none left nearby: restart from a recently used vertex, or else the next unfinished one in input order:
+		while (fan < 0 && !dead_end.empty()) {
+			uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0) fan = v;
+		}
+		while (fan < 0 && cursor < indices.size()) {
+			uint32_t v = indices[cursor++];
+			if (live[v] > 0) fan = v;
+		}
+	}
+
+	assert(out.size() == indices.size());
+	return out;
+}
+
+std::vector< uint32_t > fetch_order_remap(std::vector< uint32_t > const &indices, size_t vertex_count, size_t *used_count) {
+	assert(used_count);
+	std::vector< uint32_t > remap(vertex_count, ~0u);
+	*used_count = 0;
+	for (uint32_t v : indices) {
+		if (remap[v] == ~0u) {
+			remap[v] = uint32_t(*used_count);
+			*used_count += 1;
+		}
+	}
+	return remap;
+}
+
+float acmr(std::vector< uint32_t > const &indices, uint32_t cache_size) {
+	if (indices.size() < 3) return 0.0f;
+
+	std::vector< uint32_t > fifo(cache_size, ~0u);
+	size_t head = 0;
+	size_t misses = 0;
+	for (uint32_t v : indices) {
+		bool hit = false;
+		for (uint32_t entry : fifo) {
+			if (entry == v) hit = true;
+		}
+		if (!hit) {
+			fifo[head] = v;
+			head = (head + 1) % cache_size;
+			misses += 1;
+		}
+	}
+	return float(misses) / float(indices.size() / 3);
+}
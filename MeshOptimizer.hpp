@@ -0,0 +1,51 @@
+#pragma once
+
+//Turns triangle-list geometry into indexed geometry that is cheap for the GPU to draw:
+//  weld_vertices: merges vertices that are exactly (bitwise) equal, so each is stored -- and shaded -- once;
+//  tipsify: reorders triangles for the post-transform vertex cache (Sander, Nehab, and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007);
+//  fetch_order_remap: renumbers vertices in the order triangles first use them, so vertex fetches walk memory forward.
+//optimize_mesh does all three.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//returns remap[i] = the index, among the unique vertices, of vertex i (unique vertices are numbered in order of first appearance);
+// *unique_count gets the number of unique vertices:
+std::vector< uint32_t > weld_vertices(void const *vertices, size_t count, size_t stride, size_t *unique_count);
+
+//returns `indices` (a triangle list over vertex_count vertices) with its triangles reordered for a vertex cache of cache_size entries:
+std::vector< uint32_t > tipsify(std::vector< uint32_t > const &indices, size_t vertex_count, uint32_t cache_size);
+
+//returns remap[v] = new index of vertex v, in order of first use by `indices` (unused vertices get ~0u); *used_count gets the number used:
+std::vector< uint32_t > fetch_order_remap(std::vector< uint32_t > const &indices, size_t vertex_count, size_t *used_count);
+
+//average cache miss ratio (vertex shader invocations per triangle) of `indices` with a FIFO cache of cache_size entries:
+// (3 for unindexed geometry; 0.5 is the ideal for large regular meshes)
+float acmr(std::vector< uint32_t > const &indices, uint32_t cache_size);
+
+//converts a triangle list of vertices into welded, cache-ordered, fetch-ordered vertices and indices:
+template< typename Vertex >
+void optimize_mesh(std::vector< Vertex > const &triangles, std::vector< Vertex > *vertices, std::vector< uint32_t > *indices, uint32_t cache_size = 16) {
+	size_t unique_count = 0;
+	std::vector< uint32_t > remap = weld_vertices(triangles.data(), triangles.size(), sizeof(Vertex), &unique_count);
+
+	std::vector< Vertex > unique(unique_count);
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		unique[remap[i]] = triangles[i];
+	}
+
+	std::vector< uint32_t > ordered = tipsify(remap, unique_count, cache_size);
+
+	size_t used_count = 0;
+	std::vector< uint32_t > fetch = fetch_order_remap(ordered, unique_count, &used_count);
+
+	vertices->resize(used_count);
+	for (size_t v = 0; v < unique_count; ++v) {
+		if (fetch[v] != ~0u) (*vertices)[fetch[v]] = unique[v];
+	}
+	indices->resize(ordered.size());
+	for (size_t i = 0; i < ordered.size(); ++i) {
+		(*indices)[i] = fetch[ordered[i]];
+	}
+}
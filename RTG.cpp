@@ -11,13 +11,29 @@
 #include <vulkan/vk_enum_string_helper.h> //useful for debug output
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 #include <set>
 
+//parse an unsigned integer parameter for a command-line flag:
+static uint32_t parse_count(std::string const &flag, std::string const &val) {
+	if (val.empty()) throw std::runtime_error(flag + " should match [0-9]+, got an empty string.");
+	for (size_t i = 0; i < val.size(); ++i) {
+		if (val[i] < '0' || val[i] > '9') {
+			throw std::runtime_error(flag + " should match [0-9]+, got '" + val + "'.");
+		}
+	}
+	return uint32_t(std::stoul(val));
+}
+
 void RTG::Configuration::parse(int argc, char **argv) {
+	parse(argc, argv, nullptr);
+}
+
+void RTG::Configuration::parse(int argc, char **argv, std::function< bool(int argc, char **argv, int &argi) > const &parse_extra) {
 	for (int argi = 1; argi < argc; ++argi) {
 		std::string arg = argv[argi];
 		if (arg == "--debug") {
@@ -42,16 +58,325 @@ void RTG::Configuration::parse(int argc, char **argv) {
 			};
 			surface_extent.width = conv("width");
 			surface_extent.height = conv("height");
+		} else if (arg == "--present-mode") {
+			if (argi + 1 >= argc) throw std::runtime_error("--present-mode requires a parameter (fifo, mailbox, immediate, or fifo-relaxed).");
+			argi += 1;
+			std::string mode = argv[argi];
+			VkPresentModeKHR requested;
+			if (mode == "fifo") requested = VK_PRESENT_MODE_FIFO_KHR;
+			else if (mode == "mailbox") requested = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (mode == "immediate") requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else if (mode == "fifo-relaxed") requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			else throw std::runtime_error("--present-mode should be one of fifo, mailbox, immediate, or fifo-relaxed; got '" + mode + "'.");
+			//FIFO is the only mode every surface supports, so keep it as a fallback:
+			present_modes = { requested };
+			if (requested != VK_PRESENT_MODE_FIFO_KHR) present_modes.emplace_back(VK_PRESENT_MODE_FIFO_KHR);
+		} else if (arg == "--workspaces") {
+			if (argi + 1 >= argc) throw std::runtime_error("--workspaces requires a parameter (a workspace count).");
+			argi += 1;
+			workspaces = parse_count("--workspaces", argv[argi]);
+			if (workspaces == 0) throw std::runtime_error("--workspaces must be at least 1.");
+		} else if (arg == "--swapchain-images") {
+			if (argi + 1 >= argc) throw std::runtime_error("--swapchain-images requires a parameter (an image count).");
+			argi += 1;
+			swapchain_images = parse_count("--swapchain-images", argv[argi]);
+			if (swapchain_images.value() == 0) throw std::runtime_error("--swapchain-images must be at least 1.");
+		} else if (arg == "--no-transfer-queue") {
+			transfer_queue = false;
+		} else if (arg == "--timing-report") {
+			timing_report = true;
+		} else if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--frames") {
+			if (argi + 1 >= argc) throw std::runtime_error("--frames requires a parameter (a frame count).");
+			argi += 1;
+			frames = parse_count("--frames", argv[argi]);
+		} else if (parse_extra && parse_extra(argc, argv, argi)) {
+			//(consumed by parse_extra)
 		} else {
 			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
 		}
 	}
+
+	if (headless && !frames) {
+		throw std::runtime_error("--headless requires --frames <N> (there is no window to close).");
+	}
 }
 
 void RTG::Configuration::usage(std::function< void(const char *, const char *) > const &callback) {
 	callback("--debug, --no-debug", "Turn on/off debug and validation layers.");
 	callback("--physical-device <name>", "Run on the named physical device (guesses, otherwise).");
 	callback("--drawing-size <w> <h>", "Set the size of the surface to draw to.");
+	callback("--present-mode <mode>", "Request a present mode: fifo (default), mailbox, immediate, or fifo-relaxed. Falls back to fifo if unsupported.");
+	callback("--workspaces <N>", "Use N workspaces (frames in flight); default is 2.");
+	callback("--swapchain-images <N>", "Request N swapchain images (clamped to the surface's supported range).");
+	callback("--no-transfer-queue", "Run uploads on the graphics queue even if the device has a dedicated transfer queue.");
+	callback("--timing-report", "Print per-stage CPU frame timing statistics at exit.");
+	callback("--headless", "Don't create a window; render to offscreen images (requires --frames).");
+	callback("--frames <N>", "Exit after rendering N frames.");
+}
+
+//------------------------------------------------
+//Headless mode creates its own instance, since it can't use the
+// GLFW-dependent creation functions in refsol.
+//Both modes create the device here, so that a transfer queue can be requested:
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL headless_debug_callback(
+	VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+	VkDebugUtilsMessageTypeFlagsEXT type,
+	const VkDebugUtilsMessengerCallbackDataEXT *data,
+	void *user_data) {
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+		std::cerr << "\x1b[91m" << "E: ";
+	} else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+		std::cerr << "\x1b[33m" << "w: ";
+	} else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+		std::cerr << "\x1b[90m" << "i: ";
+	} else { //VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
+		std::cerr << "\x1b[90m" << "v: ";
+	}
+	std::cerr << data->pMessage << "\x1b[0m" << std::endl;
+
+	return VK_FALSE;
+}
+
+static void headless_create_instance(
+	VkApplicationInfo const &application_info,
+	bool debug,
+	VkInstance *instance,
+	VkDebugUtilsMessengerEXT *debug_messenger) {
+
+	std::vector< const char * > instance_extensions;
+	std::vector< const char * > instance_layers;
+	VkInstanceCreateFlags instance_flags = 0;
+
+	#if defined(__APPLE__)
+	instance_flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+	instance_extensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+	#endif
+
+	if (debug) {
+		//only ask for the validation layer if it is actually installed:
+		uint32_t count = 0;
+		VK( vkEnumerateInstanceLayerProperties(&count, nullptr) );
+		std::vector< VkLayerProperties > layers(count);
+		VK( vkEnumerateInstanceLayerProperties(&count, layers.data()) );
+		bool have_validation = std::any_of(layers.begin(), layers.end(), [](VkLayerProperties const &layer) {
+			return std::strcmp(layer.layerName, "VK_LAYER_KHRONOS_validation") == 0;
+		});
+		if (have_validation) {
+			instance_layers.emplace_back("VK_LAYER_KHRONOS_validation");
+		} else {
+			std::cerr << "WARNING: VK_LAYER_KHRONOS_validation is not available; running without validation." << std::endl;
+		}
+		instance_extensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
+
+	VkDebugUtilsMessengerCreateInfoEXT debug_messenger_create_info{
+		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+		.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT
+		                 | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT
+		                 | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
+		                 | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+		.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
+		             | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
+		             | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+		.pfnUserCallback = headless_debug_callback,
+		.pUserData = nullptr
+	};
+
+	VkInstanceCreateInfo create_info{
+		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+		.pNext = (debug ? &debug_messenger_create_info : nullptr), //pass debug structure if configured
+		.flags = instance_flags,
+		.pApplicationInfo = &application_info,
+		.enabledLayerCount = uint32_t(instance_layers.size()),
+		.ppEnabledLayerNames = instance_layers.data(),
+		.enabledExtensionCount = uint32_t(instance_extensions.size()),
+		.ppEnabledExtensionNames = instance_extensions.data()
+	};
+	VK( vkCreateInstance(&create_info, nullptr, instance) );
+
+	if (debug) {
+		PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT
+			= (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(*instance, "vkCreateDebugUtilsMessengerEXT");
+		if (!vkCreateDebugUtilsMessengerEXT) {
+			throw std::runtime_error("Failed to lookup debug utils create fn.");
+		}
+		VK( vkCreateDebugUtilsMessengerEXT(*instance, &debug_messenger_create_info, nullptr, debug_messenger) );
+	}
+}
+
+static void create_device(
+	bool debug,
+	VkPhysicalDevice physical_device,
+	VkSurfaceKHR surface, //VK_NULL_HANDLE in headless mode (no present queue or swapchain extension)
+	bool want_transfer_queue,
+	VkDevice *device,
+	VkPhysicalDeviceFeatures *enabled_features,
+	VkPhysicalDeviceVulkan12Features *enabled_vulkan12_features,
+	std::optional< uint32_t > *graphics_queue_family,
+	VkQueue *graphics_queue,
+	std::optional< uint32_t > *present_queue_family,
+	VkQueue *present_queue,
+	std::optional< uint32_t > *transfer_queue_family,
+	VkQueue *transfer_queue) {
+
+	//pick queue families:
+	{
+		uint32_t count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+		std::vector< VkQueueFamilyProperties > queue_families(count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_families.data());
+
+		for (uint32_t i = 0; i < count; ++i) {
+			if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				*graphics_queue_family = i;
+				break;
+			}
+		}
+		if (!graphics_queue_family->has_value()) {
+			throw std::runtime_error("No queue with graphics support.");
+		}
+
+		if (surface != VK_NULL_HANDLE) {
+			//prefer presenting from the graphics family (no ownership transfer needed for swapchain images):
+			auto can_present = [&](uint32_t i) {
+				VkBool32 support = VK_FALSE;
+				VK( vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &support) );
+				return support == VK_TRUE;
+			};
+			if (can_present(graphics_queue_family->value())) {
+				*present_queue_family = graphics_queue_family->value();
+			} else {
+				for (uint32_t i = 0; i < count; ++i) {
+					if (can_present(i)) {
+						*present_queue_family = i;
+						break;
+					}
+				}
+			}
+			if (!present_queue_family->has_value()) {
+				throw std::runtime_error("No queue with present support.");
+			}
+		}
+
+		//a transfer queue only helps if it isn't the graphics family; prefer the copy-only (DMA engine) family if there is one:
+		// (TRANSFER_BIT is implied for graphics and compute families, so only transfer-only families report it alone)
+		if (want_transfer_queue) {
+			auto is_transfer_only = [&](uint32_t i, VkQueueFlags others) {
+				VkQueueFlags flags = queue_families[i].queueFlags;
+				return (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & others) && queue_families[i].queueCount > 0;
+			};
+			for (uint32_t i = 0; i < count; ++i) {
+				if (is_transfer_only(i, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) {
+					*transfer_queue_family = i;
+					break;
+				}
+			}
+			if (!transfer_queue_family->has_value()) {
+				for (uint32_t i = 0; i < count; ++i) {
+					if (is_transfer_only(i, VK_QUEUE_GRAPHICS_BIT)) {
+						*transfer_queue_family = i;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	std::vector< const char * > device_extensions;
+	#if defined(__APPLE__)
+	device_extensions.emplace_back(VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME);
+	#endif
+	if (surface != VK_NULL_HANDLE) {
+		device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+
+	//one queue from each distinct family:
+	std::set< uint32_t > unique_families{ graphics_queue_family->value() };
+	if (present_queue_family->has_value()) unique_families.insert(present_queue_family->value());
+	if (transfer_queue_family->has_value()) unique_families.insert(transfer_queue_family->value());
+
+	float queue_priorities[1] = { 1.0f };
+	std::vector< VkDeviceQueueCreateInfo > queue_create_infos;
+	for (uint32_t family : unique_families) {
+		queue_create_infos.emplace_back(VkDeviceQueueCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = family,
+			.queueCount = 1,
+			.pQueuePriorities = queue_priorities,
+		});
+	}
+
+	//the Vulkan 1.2 feature struct may only be queried and enabled on a device that supports 1.2:
+	bool vulkan_1_2 = false;
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+		vulkan_1_2 = (properties.apiVersion >= VK_API_VERSION_1_2);
+	}
+
+	//turn on the optional features that are supported:
+	{
+		//(left all-false on older devices, which then use the per-texture fallback in ObjectsPipeline)
+		VkPhysicalDeviceVulkan12Features supported12{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		};
+		VkPhysicalDeviceFeatures2 supported{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = &supported12,
+		};
+		if (vulkan_1_2) {
+			vkGetPhysicalDeviceFeatures2(physical_device, &supported);
+		} else {
+			vkGetPhysicalDeviceFeatures(physical_device, &supported.features);
+		}
+
+		*enabled_features = VkPhysicalDeviceFeatures{};
+		enabled_features->samplerAnisotropy = supported.features.samplerAnisotropy;
+		enabled_features->textureCompressionBC = supported.features.textureCompressionBC;
+		enabled_features->multiDrawIndirect = supported.features.multiDrawIndirect;
+		enabled_features->drawIndirectFirstInstance = supported.features.drawIndirectFirstInstance;
+
+		*enabled_vulkan12_features = VkPhysicalDeviceVulkan12Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+			.shaderSampledImageArrayNonUniformIndexing = supported12.shaderSampledImageArrayNonUniformIndexing,
+			.descriptorBindingPartiallyBound = supported12.descriptorBindingPartiallyBound,
+			.descriptorBindingVariableDescriptorCount = supported12.descriptorBindingVariableDescriptorCount,
+			.runtimeDescriptorArray = supported12.runtimeDescriptorArray,
+		};
+	}
+
+	VkDeviceCreateInfo create_info{
+		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = (vulkan_1_2 ? enabled_vulkan12_features : nullptr),
+		.queueCreateInfoCount = uint32_t(queue_create_infos.size()),
+		.pQueueCreateInfos = queue_create_infos.data(),
+		//device layers are depreciated; and so are ignored.
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = uint32_t(device_extensions.size()),
+		.ppEnabledExtensionNames = device_extensions.data(),
+		.pEnabledFeatures = enabled_features,
+	};
+	VK( vkCreateDevice(physical_device, &create_info, nullptr, device) );
+
+	vkGetDeviceQueue(*device, graphics_queue_family->value(), 0, graphics_queue);
+	if (present_queue_family->has_value()) {
+		vkGetDeviceQueue(*device, present_queue_family->value(), 0, present_queue);
+	}
+	if (transfer_queue_family->has_value()) {
+		vkGetDeviceQueue(*device, transfer_queue_family->value(), 0, transfer_queue);
+	}
+
+	if (debug) {
+		std::cout << "Using queue family " << graphics_queue_family->value() << " for graphics";
+		if (present_queue_family->has_value()) std::cout << ", " << present_queue_family->value() << " for present";
+		if (transfer_queue_family->has_value()) std::cout << ", " << transfer_queue_family->value() << " for transfer";
+		else std::cout << " (no dedicated transfer queue)";
+		std::cout << "." << std::endl;
+	}
 }
 
 RTG::RTG(Configuration const &configuration_) : helpers(*this) {
@@ -61,54 +386,117 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 
 	//fill in flags/extensions/layers information:
 
-	//create the `instance` (main handle to Vulkan library):
-	refsol::RTG_constructor_create_instance(
-		configuration.application_info,
-		configuration.debug,
-		&instance,
-		&debug_messenger
-	);
-
-	//create the `window` and `surface` (where things get drawn):
-	refsol::RTG_constructor_create_surface(
-		configuration.application_info,
-		configuration.debug,
-		configuration.surface_extent,
-		instance,
-		&window,
-		&surface
-	);
-
-	//select the `physical_device` -- the gpu that will be used to draw:
-	refsol::RTG_constructor_select_physical_device(
-		configuration.debug,
-		configuration.physical_device_name,
-		instance,
-		&physical_device
-	);
-
-	//select the `surface_format` and `present_mode` which control how colors are represented on the surface and how new images are supplied to the surface:
-	refsol::RTG_constructor_select_format_and_mode(
-		configuration.debug,
-		configuration.surface_formats,
-		configuration.present_modes,
-		physical_device,
-		surface,
-		&surface_format,
-		&present_mode
-	);
-
-	//create the `device` (logical interface to the GPU) and the `queue`s to which we can submit commands:
-	refsol::RTG_constructor_create_device(
-		configuration.debug,
-		physical_device,
-		surface,
-		&device,
-		&graphics_queue_family,
-		&graphics_queue,
-		&present_queue_family,
-		&present_queue
-	);
+	if (configuration.headless) {
+		//create the `instance` without any window-system extensions:
+		headless_create_instance(
+			configuration.application_info,
+			configuration.debug,
+			&instance,
+			&debug_messenger
+		);
+
+		//(no `window` or `surface` in headless mode)
+
+		//select the `physical_device` -- the gpu that will be used to draw:
+		refsol::RTG_constructor_select_physical_device(
+			configuration.debug,
+			configuration.physical_device_name,
+			instance,
+			&physical_device
+		);
+
+		//the "surface" format is just the first requested format that can be rendered to:
+		{
+			std::vector< VkFormat > candidates;
+			for (VkSurfaceFormatKHR const &format : configuration.surface_formats) {
+				candidates.emplace_back(format.format);
+			}
+			VkFormat format = helpers.find_image_format(candidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+			for (VkSurfaceFormatKHR const &candidate : configuration.surface_formats) {
+				if (candidate.format == format) {
+					surface_format = candidate;
+					break;
+				}
+			}
+		}
+		//(present_mode doesn't matter in headless mode)
+
+		//create the `device` and a graphics `queue` (there is nothing to present to):
+		create_device(
+			configuration.debug,
+			physical_device,
+			VK_NULL_HANDLE,
+			configuration.transfer_queue,
+			&device,
+			&enabled_features,
+			&enabled_vulkan12_features,
+			&graphics_queue_family,
+			&graphics_queue,
+			&present_queue_family,
+			&present_queue,
+			&transfer_queue_family,
+			&transfer_queue
+		);
+	} else {
+		//create the `instance` (main handle to Vulkan library):
+		refsol::RTG_constructor_create_instance(
+			configuration.application_info,
+			configuration.debug,
+			&instance,
+			&debug_messenger
+		);
+
+		//create the `window` and `surface` (where things get drawn):
+		refsol::RTG_constructor_create_surface(
+			configuration.application_info,
+			configuration.debug,
+			configuration.surface_extent,
+			instance,
+			&window,
+			&surface
+		);
+
+		//select the `physical_device` -- the gpu that will be used to draw:
+		refsol::RTG_constructor_select_physical_device(
+			configuration.debug,
+			configuration.physical_device_name,
+			instance,
+			&physical_device
+		);
+
+		//select the `surface_format` and `present_mode` which control how colors are represented on the surface and how new images are supplied to the surface:
+		refsol::RTG_constructor_select_format_and_mode(
+			configuration.debug,
+			configuration.surface_formats,
+			configuration.present_modes,
+			physical_device,
+			surface,
+			&surface_format,
+			&present_mode
+		);
+
+		//report if the preferred present mode wasn't available:
+		if (!configuration.present_modes.empty() && present_mode != configuration.present_modes[0]) {
+			std::cerr << "Present mode " << string_VkPresentModeKHR(configuration.present_modes[0]) << " is not supported by this surface; falling back to " << string_VkPresentModeKHR(present_mode) << "." << std::endl;
+		}
+
+		//create the `device` (logical interface to the GPU) and the `queue`s to which we can submit commands:
+		create_device(
+			configuration.debug,
+			physical_device,
+			surface,
+			configuration.transfer_queue,
+			&device,
+			&enabled_features,
+			&enabled_vulkan12_features,
+			&graphics_queue_family,
+			&graphics_queue,
+			&present_queue_family,
+			&present_queue,
+			&transfer_queue_family,
+			&transfer_queue
+		);
+	}
 
 	//run any resource creation required by Helpers structure:
 	helpers.create();
@@ -143,41 +531,493 @@ RTG::~RTG() {
 	//destroy Helpers structure resources:
 	helpers.destroy();
 
+	//destroy the device (mirrors create_device):
+	if (device != VK_NULL_HANDLE) {
+		vkDestroyDevice(device, nullptr);
+		device = VK_NULL_HANDLE;
+	}
+
 	//destroy the rest of the resources:
-	refsol::RTG_destructor( &device, &surface, &window, &debug_messenger, &instance );
+	if (configuration.headless) {
+		//(mirrors headless_create_instance)
+		if (debug_messenger != VK_NULL_HANDLE) {
+			PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT
+				= (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+			if (vkDestroyDebugUtilsMessengerEXT) {
+				vkDestroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
+			}
+			debug_messenger = VK_NULL_HANDLE;
+		}
+		if (instance != VK_NULL_HANDLE) {
+			vkDestroyInstance(instance, nullptr);
+			instance = VK_NULL_HANDLE;
+		}
+	} else {
+		//(device is already null, so this only cleans up the surface, window, and instance)
+		refsol::RTG_destructor( &device, &surface, &window, &debug_messenger, &instance );
+	}
 
 }
 
 
 void RTG::recreate_swapchain() {
-	refsol::RTG_recreate_swapchain(
-		configuration.debug,
-		device,
-		physical_device,
-		surface,
-		surface_format,
-		present_mode,
-		graphics_queue_family,
-		present_queue_family,
-		&swapchain,
-		&swapchain_extent,
-		&swapchain_images,
-		&swapchain_image_views,
-		&swapchain_image_dones
-	);
+	if (configuration.headless) {
+		//clean up any existing images (waiting until they are no longer in use):
+		if (!headless_swapchain.empty()) {
+			VK( vkDeviceWaitIdle(device) );
+			destroy_swapchain();
+		}
+
+		//headless "swapchain" is a ring of plain images, by default at least as long as the number of workspaces:
+		uint32_t count = configuration.swapchain_images.value_or(std::max< uint32_t >(3, configuration.workspaces));
+
+		swapchain_extent = configuration.surface_extent;
+		swapchain_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; //rendered to, and can be read back
+		headless_swapchain.reserve(count);
+		Helpers::TagScope tag(helpers, Helpers::SwapchainMemory);
+		for (uint32_t i = 0; i < count; ++i) {
+			headless_swapchain.emplace_back(helpers.create_image(
+				swapchain_extent,
+				surface_format.format,
+				VK_IMAGE_TILING_OPTIMAL,
+				swapchain_usage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped
+			));
+			swapchain_images.emplace_back(headless_swapchain.back().handle);
+		}
+	} else {
+		//clean up the existing swapchain (waiting until its images are no longer in use):
+		if (swapchain != VK_NULL_HANDLE) {
+			VK( vkDeviceWaitIdle(device) );
+			destroy_swapchain();
+		}
+
+		//determine size, image count, and transform for swapchain:
+		VkSurfaceCapabilitiesKHR capabilities;
+		VK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities) );
+
+		swapchain_extent = capabilities.currentExtent;
+		if (swapchain_extent.width == 0xFFFFFFFF && swapchain_extent.height == 0xFFFFFFFF) {
+			//surface size is determined by the swapchain, so use the window's size (or, failing that, the configured size):
+			VkExtent2D size = configuration.surface_extent;
+			int width = 0, height = 0;
+			glfwGetFramebufferSize(window, &width, &height);
+			if (width > 0 && height > 0) size = VkExtent2D{ .width = uint32_t(width), .height = uint32_t(height) };
+			swapchain_extent.width = std::clamp(size.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+			swapchain_extent.height = std::clamp(size.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+		}
+
+		uint32_t requested_count = configuration.swapchain_images.value_or(capabilities.minImageCount + 1);
+		uint32_t requested_count_clamped = std::max(requested_count, capabilities.minImageCount);
+		if (capabilities.maxImageCount != 0) {
+			requested_count_clamped = std::min(requested_count_clamped, capabilities.maxImageCount);
+		}
+		if (configuration.swapchain_images && requested_count_clamped != requested_count) {
+			std::cerr << "Surface supports " << capabilities.minImageCount << " to "
+			          << (capabilities.maxImageCount == 0 ? std::string("any number of") : std::to_string(capabilities.maxImageCount))
+			          << " swapchain images; requesting " << requested_count_clamped << " instead of " << requested_count << "." << std::endl;
+		}
+
+		//if graphics and present queues are different, the swapchain images need to be shared between them:
+		std::vector< uint32_t > queue_family_indices{
+			graphics_queue_family.value(),
+			present_queue_family.value()
+		};
+		bool concurrent = (queue_family_indices[0] != queue_family_indices[1]);
+
+		//images will be rendered to; and, when the surface allows it, copied from (e.g., for readback):
+		VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		if (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+			image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+
+		VkSwapchainCreateInfoKHR create_info{
+			.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+			.surface = surface,
+			.minImageCount = requested_count_clamped,
+			.imageFormat = surface_format.format,
+			.imageColorSpace = surface_format.colorSpace,
+			.imageExtent = swapchain_extent,
+			.imageArrayLayers = 1,
+			.imageUsage = image_usage,
+			.imageSharingMode = (concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE),
+			.queueFamilyIndexCount = (concurrent ? uint32_t(queue_family_indices.size()) : 0),
+			.pQueueFamilyIndices = (concurrent ? queue_family_indices.data() : nullptr),
+			.preTransform = capabilities.currentTransform,
+			.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+			.presentMode = present_mode,
+			.clipped = VK_TRUE,
+			.oldSwapchain = VK_NULL_HANDLE //NOTE: could be more efficient by passing old swapchain handle here instead of destroying it
+		};
+		VK( vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain) );
+		swapchain_usage = image_usage;
+
+		//get the swapchain images:
+		{
+			uint32_t count = 0;
+			VK( vkGetSwapchainImagesKHR(device, swapchain, &count, nullptr) );
+			swapchain_images.resize(count);
+			VK( vkGetSwapchainImagesKHR(device, swapchain, &count, swapchain_images.data()) );
+		}
+	}
+
+	//create views for the swapchain images:
+	for (VkImage image : swapchain_images) {
+		VkImageViewCreateInfo view_create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = surface_format.format,
+			.components{
+				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.a = VK_COMPONENT_SWIZZLE_IDENTITY
+			},
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+		};
+		VkImageView image_view = VK_NULL_HANDLE;
+		VK( vkCreateImageView(device, &view_create_info, nullptr, &image_view) );
+		swapchain_image_views.emplace_back(image_view);
+	}
+
+	//create semaphores to signal when each image is ready to present:
+	for (size_t i = 0; i < swapchain_images.size(); ++i) {
+		VkSemaphoreCreateInfo semaphore_create_info{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		};
+		VkSemaphore image_done = VK_NULL_HANDLE;
+		VK( vkCreateSemaphore(device, &semaphore_create_info, nullptr, &image_done) );
+		swapchain_image_dones.emplace_back(image_done);
+	}
+
+	if (configuration.debug) {
+		std::cout << (configuration.headless ? "Headless swapchain" : "Swapchain") << " is now " << swapchain_images.size() << " images of size " << swapchain_extent.width << "x" << swapchain_extent.height << " " << string_VkFormat(surface_format.format);
+		if (!configuration.headless) std::cout << " (present mode " << string_VkPresentModeKHR(present_mode) << ")";
+		std::cout << "." << std::endl;
+	}
 }
 
 
 void RTG::destroy_swapchain() {
-	refsol::RTG_destroy_swapchain(
-		device,
-		&swapchain,
-		&swapchain_images,
-		&swapchain_image_views,
-		&swapchain_image_dones
-	);
+	for (VkSemaphore &image_done : swapchain_image_dones) {
+		vkDestroySemaphore(device, image_done, nullptr);
+		image_done = VK_NULL_HANDLE;
+	}
+	swapchain_image_dones.clear();
+
+	for (VkImageView &image_view : swapchain_image_views) {
+		vkDestroyImageView(device, image_view, nullptr);
+		image_view = VK_NULL_HANDLE;
+	}
+	swapchain_image_views.clear();
+
+	//the images themselves are owned by the swapchain (or, in headless mode, by headless_swapchain):
+	swapchain_images.clear();
+
+	if (configuration.headless) {
+		for (Helpers::AllocatedImage &image : headless_swapchain) {
+			helpers.destroy_image(std::move(image));
+		}
+		headless_swapchain.clear();
+	} else {
+		vkDestroySwapchainKHR(device, swapchain, nullptr);
+		swapchain = VK_NULL_HANDLE;
+	}
 }
 
+//GLFW callbacks used by RTG::run; the window's user pointer is the event queue:
+static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos);
+static void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+static void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int mods);
+
 void RTG::run(Application &application) {
-	refsol::RTG_run(*this, application);
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms_between = [](Clock::time_point const &a, Clock::time_point const &b) {
+		return float(std::chrono::duration< double, std::milli >(b - a).count());
+	};
+
+	auto on_swapchain = [&]() {
+		application.on_swapchain(*this, SwapchainEvent{
+			.extent = swapchain_extent,
+			.images = swapchain_images,
+			.image_views = swapchain_image_views,
+		});
+	};
+
+	//recreate the swapchain (e.g., because the window was resized) and tell everyone about it:
+	auto resize = [&]() {
+		recreate_swapchain();
+		on_swapchain();
+		if (hooks.on_resize) hooks.on_resize(swapchain_extent);
+	};
+
+	on_swapchain();
+
+	//events from GLFW's callbacks are queued, then passed to the application once per frame:
+	std::vector< InputEvent > event_queue;
+	int framebuffer_width = 0, framebuffer_height = 0; //(used to notice resizes)
+	if (!configuration.headless) {
+		glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+		glfwSetWindowUserPointer(window, &event_queue);
+		glfwSetCursorPosCallback(window, cursor_pos_callback);
+		glfwSetMouseButtonCallback(window, mouse_button_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+		glfwSetKeyCallback(window, key_callback);
+	}
+
+	Clock::time_point start = Clock::now();
+	Clock::time_point before = start;
+	uint32_t next_image = 0; //(headless mode "acquires" images round-robin)
+	uint64_t frame = 0;
+
+	while (!configuration.frames || frame < configuration.frames.value()) {
+		Clock::time_point frame_start = Clock::now();
+
+		if (!configuration.headless) {
+			if (glfwWindowShouldClose(window)) break;
+
+			glfwPollEvents();
+			for (InputEvent const &event : event_queue) {
+				application.on_input(event);
+			}
+			event_queue.clear();
+
+			//don't render while minimized (a zero-sized swapchain isn't allowed):
+			int width = 0, height = 0;
+			glfwGetFramebufferSize(window, &width, &height);
+			if (width == 0 || height == 0) {
+				glfwWaitEvents();
+				continue;
+			}
+
+			//notice resizes that the surface doesn't report as out-of-date:
+			if (width != framebuffer_width || height != framebuffer_height) {
+				framebuffer_width = width;
+				framebuffer_height = height;
+				resize();
+			}
+		}
+
+		FrameTiming::Sample sample{ .frame = frame };
+		Clock::time_point after_events = Clock::now();
+
+		//get the next workspace and wait until it is not being used:
+		assert(next_workspace < workspaces.size());
+		uint32_t workspace_index = next_workspace;
+		PerWorkspace &workspace = workspaces[workspace_index];
+		VK( vkWaitForFences(device, 1, &workspace.workspace_available, VK_TRUE, UINT64_MAX) );
+		Clock::time_point after_wait = Clock::now();
+		sample.ms[FrameTiming::Wait] = ms_between(after_events, after_wait);
+
+		if (hooks.pre_acquire) hooks.pre_acquire(workspace_index);
+
+		//acquire the next image, which signals image_available when it is ready to be rendered to:
+		uint32_t image_index = -1U;
+		if (configuration.headless) {
+			image_index = next_image;
+			next_image = (next_image + 1) % uint32_t(swapchain_images.size());
+
+			//"acquire" by signalling image_available, so the application can wait on it as usual:
+			VkSubmitInfo submit_info{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.signalSemaphoreCount = 1,
+				.pSignalSemaphores = &workspace.image_available,
+			};
+			VK( vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) );
+		} else {
+			VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, workspace.image_available, VK_NULL_HANDLE, &image_index);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				//nothing was acquired (and the workspace's fence is still signalled), so recreate and try again:
+				resize();
+				continue;
+			} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				throw std::runtime_error("Failed to acquire swapchain image (" + std::string(string_VkResult(result)) + ")!");
+			}
+			//(suboptimal images are still presentable; the swapchain is recreated after presenting)
+		}
+
+		//the workspace is now committed to this frame:
+		VK( vkResetFences(device, 1, &workspace.workspace_available) );
+		next_workspace = (next_workspace + 1) % uint32_t(workspaces.size());
+
+		Clock::time_point after_acquire = Clock::now();
+		sample.ms[FrameTiming::Acquire] = ms_between(after_wait, after_acquire);
+
+		if (hooks.post_acquire) hooks.post_acquire(workspace_index, image_index);
+
+		{ //elapsed time since last frame (clamped to avoid big jumps):
+			Clock::time_point now = Clock::now();
+			float dt = float(std::chrono::duration< double >(now - before).count());
+			before = now;
+			dt = std::min(dt, 0.1f);
+
+			application.update(dt);
+		}
+		Clock::time_point after_update = Clock::now();
+		sample.ms[FrameTiming::Update] = ms_between(after_acquire, after_update);
+
+		RenderParams render_params{
+			.workspace_index = workspace_index,
+			.image_index = image_index,
+			.image_available = workspace.image_available,
+			.image_done = swapchain_image_dones[image_index],
+			.workspace_available = workspace.workspace_available,
+		};
+		if (hooks.pre_submit) hooks.pre_submit(render_params);
+
+		application.render(*this, render_params);
+		Clock::time_point after_render = Clock::now();
+		sample.ms[FrameTiming::Render] = ms_between(after_update, after_render);
+
+		//queue the image for presentation once image_done is signalled:
+		VkResult present_result = VK_SUCCESS;
+		if (configuration.headless) {
+			//"present" by consuming the image_done signal, so the semaphore can be re-used:
+			VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo submit_info{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &swapchain_image_dones[image_index],
+				.pWaitDstStageMask = &wait_stage,
+			};
+			VK( vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) );
+		} else {
+			VkPresentInfoKHR present_info{
+				.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &swapchain_image_dones[image_index],
+				.swapchainCount = 1,
+				.pSwapchains = &swapchain,
+				.pImageIndices = &image_index,
+			};
+			present_result = vkQueuePresentKHR(present_queue, &present_info);
+			if (present_result != VK_SUCCESS && present_result != VK_SUBOPTIMAL_KHR && present_result != VK_ERROR_OUT_OF_DATE_KHR) {
+				throw std::runtime_error("Failed to queue presentation of image (" + std::string(string_VkResult(present_result)) + ")!");
+			}
+		}
+		Clock::time_point after_present = Clock::now();
+		sample.ms[FrameTiming::Present] = ms_between(after_render, after_present);
+
+		if (hooks.post_present) hooks.post_present(workspace_index, image_index, present_result);
+
+		if (present_result == VK_SUBOPTIMAL_KHR || present_result == VK_ERROR_OUT_OF_DATE_KHR) {
+			//(the image was still consumed, so this frame counts)
+			resize();
+		}
+
+		//event handling (and anything hooks did after presenting) is counted as "other":
+		Clock::time_point frame_end = Clock::now();
+		sample.frame_ms = ms_between(frame_start, frame_end);
+		sample.ms[FrameTiming::Other] = ms_between(frame_start, after_events) + ms_between(after_present, frame_end);
+		timing.push(sample);
+
+		frame += 1;
+	}
+
+	//wait for all rendering to actually finish before returning (or reporting):
+	VK( vkDeviceWaitIdle(device) );
+
+	if (!configuration.headless) {
+		glfwSetCursorPosCallback(window, nullptr);
+		glfwSetMouseButtonCallback(window, nullptr);
+		glfwSetScrollCallback(window, nullptr);
+		glfwSetKeyCallback(window, nullptr);
+		glfwSetWindowUserPointer(window, nullptr);
+	}
+
+	double elapsed = std::chrono::duration< double >(Clock::now() - start).count();
+	std::cout << (configuration.headless ? "Headless: rendered " : "Rendered ") << frame << " frames in " << elapsed << " seconds ("
+	          << (elapsed > 0.0 ? frame / elapsed : 0.0) << " frames/second)." << std::endl;
+
+	if (configuration.timing_report) timing.report(std::cout);
+}
+
+//bitfield of (1 << GLFW_MOUSE_BUTTON_*) for buttons currently held:
+static uint8_t mouse_button_state(GLFWwindow *window) {
+	uint8_t state = 0;
+	for (int button = 0; button < 8; ++button) {
+		if (glfwGetMouseButton(window, button) == GLFW_PRESS) state |= uint8_t(1 << button);
+	}
+	return state;
+}
+
+//GLFW reports the cursor in screen coordinates, but InputEvent uses swapchain (framebuffer) pixels:
+static void cursor_to_pixels(GLFWwindow *window, double xpos, double ypos, float *x, float *y) {
+	int window_width = 0, window_height = 0;
+	int framebuffer_width = 0, framebuffer_height = 0;
+	glfwGetWindowSize(window, &window_width, &window_height);
+	glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+	*x = float(window_width > 0 ? xpos * framebuffer_width / window_width : xpos);
+	*y = float(window_height > 0 ? ypos * framebuffer_height / window_height : ypos);
+}
+
+static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos) {
+	std::vector< InputEvent > *event_queue = reinterpret_cast< std::vector< InputEvent > * >(glfwGetWindowUserPointer(window));
+	if (!event_queue) return;
+
+	InputEvent event;
+	std::memset(&event, '\0', sizeof(event));
+
+	event.type = InputEvent::MouseMotion;
+	cursor_to_pixels(window, xpos, ypos, &event.motion.x, &event.motion.y);
+	event.motion.state = mouse_button_state(window);
+
+	event_queue->emplace_back(event);
+}
+
+static void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+	std::vector< InputEvent > *event_queue = reinterpret_cast< std::vector< InputEvent > * >(glfwGetWindowUserPointer(window));
+	if (!event_queue) return;
+	if (action != GLFW_PRESS && action != GLFW_RELEASE) return;
+
+	InputEvent event;
+	std::memset(&event, '\0', sizeof(event));
+
+	event.type = (action == GLFW_PRESS ? InputEvent::MouseButtonDown : InputEvent::MouseButtonUp);
+	double xpos = 0.0, ypos = 0.0;
+	glfwGetCursorPos(window, &xpos, &ypos);
+	cursor_to_pixels(window, xpos, ypos, &event.button.x, &event.button.y);
+	event.button.state = mouse_button_state(window);
+	event.button.button = uint8_t(button);
+	event.button.mods = uint8_t(mods);
+
+	event_queue->emplace_back(event);
+}
+
+static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+	std::vector< InputEvent > *event_queue = reinterpret_cast< std::vector< InputEvent > * >(glfwGetWindowUserPointer(window));
+	if (!event_queue) return;
+
+	InputEvent event;
+	std::memset(&event, '\0', sizeof(event));
+
+	event.type = InputEvent::MouseWheel;
+	event.wheel.x = float(xoffset);
+	event.wheel.y = float(yoffset);
+
+	event_queue->emplace_back(event);
+}
+
+static void key_callback(GLFWwindow *window, int key, int /*scancode*/, int action, int mods) {
+	std::vector< InputEvent > *event_queue = reinterpret_cast< std::vector< InputEvent > * >(glfwGetWindowUserPointer(window));
+	if (!event_queue) return;
+	if (action != GLFW_PRESS && action != GLFW_RELEASE) return; //(key repeats are ignored)
+
+	InputEvent event;
+	std::memset(&event, '\0', sizeof(event));
+
+	event.type = (action == GLFW_PRESS ? InputEvent::KeyDown : InputEvent::KeyUp);
+	event.key.key = key;
+	event.key.mods = mods;
+
+	event_queue->emplace_back(event);
 }
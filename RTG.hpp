@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FrameTiming.hpp"
 #include "Helpers.hpp"
 #include "InputEvent.hpp"
 
@@ -63,20 +64,44 @@ struct RTG {
 			VkSurfaceFormatKHR{ .format = VK_FORMAT_B8G8R8A8_SRGB, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
 		};
 		//requested (priority-ranked) presentation modes for output surface: (will use first available)
+		// `--present-mode <fifo|mailbox|immediate|fifo-relaxed>` command-line flag (falls back to fifo, which is always supported)
 		std::vector< VkPresentModeKHR > present_modes{
 			VK_PRESENT_MODE_FIFO_KHR
 		};
 
+		//if set, request this many swapchain images (clamped to what the surface supports); otherwise, use one more than the minimum:
+		// `--swapchain-images <N>` command-line flag
+		std::optional< uint32_t > swapchain_images;
+
 		//requested size of the output surface:
 		// `--drawing-size <w> <h>` command-line flag
 		VkExtent2D surface_extent{ .width = 800, .height=540 };
 
 		//how many "workspaces" (frames that can currently be being worked on by the CPU or GPU) to use:
+		// `--workspaces <N>` command-line flag
 		uint32_t workspaces = 2;
 
+		//if true, don't create a window or surface; render into RTG-owned images instead:
+		// `--headless` command-line flag
+		bool headless = false;
+
+		//if set, exit after this many frames have been rendered:
+		// `--frames <N>` command-line flag (required in headless mode)
+		std::optional< uint32_t > frames;
+
+		//if true, run Helpers uploads on a dedicated transfer queue (when the device has one):
+		// `--no-transfer-queue` command-line flag
+		bool transfer_queue = true;
+
+		//if true, print per-stage CPU frame timing statistics when run() returns:
+		// `--timing-report` command-line flag
+		bool timing_report = false;
+
 		//for configuration construction + management:
 		Configuration() = default;
 		void parse(int argc, char **argv); //parse command-line options; throws on error
+		//as above, but offers unrecognized options to `parse_extra`, which returns true (after advancing argi past any parameters) if it consumed argv[argi]:
+		void parse(int argc, char **argv, std::function< bool(int argc, char **argv, int &argi) > const &parse_extra);
 		static void usage(std::function< void(const char *, const char *) > const &callback); //reports command line usage by passing flag and description to callback.
 	};
 
@@ -94,6 +119,10 @@ struct RTG {
 	VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
+	//optional device features that the physical device supports and so were enabled (e.g., samplerAnisotropy):
+	VkPhysicalDeviceFeatures enabled_features{};
+	//...and Vulkan 1.2 features (descriptor indexing, for bindless texture arrays); pNext is always nullptr:
+	VkPhysicalDeviceVulkan12Features enabled_vulkan12_features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
 
 	//queue for graphics and transfer operations:
 	std::optional< uint32_t > graphics_queue_family;
@@ -103,6 +132,11 @@ struct RTG {
 	std::optional< uint32_t > present_queue_family;
 	VkQueue present_queue = VK_NULL_HANDLE;
 
+	//transfer-only queue (from a family without graphics support) used for uploads, if the device has one:
+	// (resources written on it must be handed to graphics_queue_family; see Helpers::acquire_uploads)
+	std::optional< uint32_t > transfer_queue_family;
+	VkQueue transfer_queue = VK_NULL_HANDLE;
+
 	//-------------------------------------------------
 	//Handles for the window and surface:
 
@@ -123,6 +157,10 @@ struct RTG {
 	std::vector< VkImage > swapchain_images; //images in the swapchain
 	std::vector< VkImageView > swapchain_image_views; //image views of the images in the swapchain
 	std::vector< VkSemaphore > swapchain_image_dones; //image is done being rendered to and is ready for presentation
+	VkImageUsageFlags swapchain_usage = 0; //how the swapchain images may be used (VK_IMAGE_USAGE_TRANSFER_SRC_BIT means they can be read back, e.g., for screenshots)
+
+	//in headless mode, the images in swapchain_images are allocated by RTG itself:
+	std::vector< Helpers::AllocatedImage > headless_swapchain;
 
 	//swapchain management: (used from RTG::RTG(), RTG::~RTG(), and RTG::run() [on resize])
 	void recreate_swapchain();
@@ -147,9 +185,29 @@ struct RTG {
 	//run an application (calls 'update', 'resize', 'handle_event', and 'render' functions on application):
 	void run(Application &);
 
+	//CPU time spent in each stage of recent frames, recorded by run():
+	// (applications can poll this, e.g., `timing.latest(&sample)` from update())
+	FrameTiming timing;
+
 	struct SwapchainEvent;
 	struct RenderParams;
 
+	//optional callbacks made by run() at fixed points in every frame, for instrumentation and pacing:
+	// (all are called on the thread that called run())
+	struct Hooks {
+		//workspace's fence has signalled; about to acquire a swapchain image for it:
+		std::function< void(uint32_t workspace_index) > pre_acquire;
+		//image acquired (its image_available semaphore will be signalled); about to call Application::update:
+		std::function< void(uint32_t workspace_index, uint32_t image_index) > post_acquire;
+		//about to call Application::render, which records and submits the frame's work:
+		std::function< void(RenderParams const &) > pre_submit;
+		//image queued for presentation (result is from vkQueuePresentKHR, or VK_SUCCESS in headless mode):
+		std::function< void(uint32_t workspace_index, uint32_t image_index, VkResult result) > post_present;
+		//swapchain was recreated, and Application::on_swapchain has been called:
+		std::function< void(VkExtent2D const &extent) > on_resize;
+	};
+	Hooks hooks;
+
 	//inherit from application to make something to pass to run:
 	struct Application {
 		//handle user input: (called when user interacts)
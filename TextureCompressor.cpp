@@ -0,0 +1,128 @@
+//Offline texture compressor: converts an image (anything stb_image reads) to a KTX2 file of block-compressed data with a full mip chain.
+//
+//usage: texture-compressor [--bc1|--bc4|--bc7] [--srgb] [--no-mips] <input image> <output.ktx2>
+//  --bc1     opaque color, 4 bits/texel
+//  --bc4     single channel (the red channel of the input), 4 bits/texel
+//  --bc7     color + alpha, 8 bits/texel (default)
+//  --srgb    data is sRGB-encoded color (mips are filtered in linear light; not valid with --bc4)
+//  --no-mips only store level 0
+//
+//(built and run over Textures/ by Maekfile.js)
+
+#include "BCEncoder.hpp"
+#include "ImageLoader.hpp"
+#include "KTX2.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static float srgb_to_linear(float value) {
+	return (value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f));
+}
+
+static float linear_to_srgb(float value) {
+	return (value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f);
+}
+
+//image with float channels (linear light for sRGB color, so averaging is correct):
+struct FloatImage {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector< float > rgba;
+};
+
+//2x2 box filter down to the next mip level (odd sizes clamp at the edge):
+static FloatImage downsample(FloatImage const &src) {
+	FloatImage dst;
+	dst.width = std::max(src.width / 2, 1u);
+	dst.height = std::max(src.height / 2, 1u);
+	dst.rgba.resize(size_t(dst.width) * dst.height * 4);
+	for (uint32_t y = 0; y < dst.height; ++y) {
+		for (uint32_t x = 0; x < dst.width; ++x) {
+			uint32_t x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+			uint32_t y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+			for (uint32_t c = 0; c < 4; ++c) {
+				auto at = [&](uint32_t sx, uint32_t sy) { return src.rgba[(size_t(sy) * src.width + sx) * 4 + c]; };
+				dst.rgba[(size_t(y) * dst.width + x) * 4 + c] = 0.25f * (at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1));
+			}
+		}
+	}
+	return dst;
+}
+
+static std::vector< uint8_t > to_bytes(FloatImage const &image, bool srgb) {
+	std::vector< uint8_t > bytes(image.rgba.size());
+	for (size_t i = 0; i < image.rgba.size(); ++i) {
+		float value = image.rgba[i];
+		if (srgb && i % 4 != 3) value = linear_to_srgb(value); //(alpha is always linear)
+		bytes[i] = uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+	return bytes;
+}
+
+int main(int argc, char **argv) {
+	try {
+		enum { BC1, BC4, BC7 } codec = BC7;
+		bool srgb = false;
+		bool mips = true;
+		std::vector< std::string > files;
+		for (int argi = 1; argi < argc; ++argi) {
+			std::string arg = argv[argi];
+			if (arg == "--bc1") codec = BC1;
+			else if (arg == "--bc4") codec = BC4;
+			else if (arg == "--bc7") codec = BC7;
+			else if (arg == "--srgb") srgb = true;
+			else if (arg == "--no-mips") mips = false;
+			else if (arg.size() > 2 && arg.substr(0, 2) == "--") throw std::runtime_error("Unrecognized option '" + arg + "'.");
+			else files.emplace_back(arg);
+		}
+		if (files.size() != 2) {
+			throw std::runtime_error("usage: texture-compressor [--bc1|--bc4|--bc7] [--srgb] [--no-mips] <input image> <output.ktx2>");
+		}
+		if (codec == BC4 && srgb) throw std::runtime_error("BC4 has no sRGB variant.");
+
+		VkFormat format;
+		if (codec == BC1) format = (srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+		else if (codec == BC4) format = VK_FORMAT_BC4_UNORM_BLOCK;
+		else format = (srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK);
+
+		//rows come out bottom-to-top, just as the viewer uploads them:
+		DecodedImage decoded = ImageLoader::Load(files[0]);
+		if (!decoded.Pixels) throw std::runtime_error("Failed to read '" + files[0] + "'.");
+
+		FloatImage level;
+		level.width = uint32_t(decoded.Width);
+		level.height = uint32_t(decoded.Height);
+		level.rgba.resize(decoded.Size());
+		unsigned char const *pixels = decoded.Pixels.get();
+		for (size_t i = 0; i < level.rgba.size(); ++i) {
+			float value = pixels[i] / 255.0f;
+			level.rgba[i] = (srgb && i % 4 != 3 ? srgb_to_linear(value) : value);
+		}
+
+		std::vector< std::vector< uint8_t > > levels;
+		size_t original_size = 0;
+		while (true) {
+			std::vector< uint8_t > bytes = to_bytes(level, srgb);
+			original_size += bytes.size();
+			levels.emplace_back(bc_encode_image(format, level.width, level.height, bytes.data()));
+			if (!mips || (level.width == 1 && level.height == 1)) break;
+			level = downsample(level);
+		}
+
+		KTX2Texture::write(files[1], format, uint32_t(decoded.Width), uint32_t(decoded.Height), levels);
+
+		size_t compressed_size = 0;
+		for (auto const &data : levels) compressed_size += data.size();
+		std::cout << "Wrote '" << files[1] << "': " << decoded.Width << "x" << decoded.Height << ", " << levels.size() << " levels, "
+		          << compressed_size << " bytes (from " << original_size << " as RGBA8)." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
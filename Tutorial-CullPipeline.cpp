@@ -0,0 +1,111 @@
+#include "Tutorial.hpp"
+#include "VK.hpp"
+
+#include "Helpers.hpp"
+
+static uint32_t comp_code[] =
+#include "spv/cull.comp.inl"
+;
+
+void Tutorial::CullPipeline::Create(RTG &rtg)
+{
+    VkShaderModule Comp_Module = rtg.helpers.create_shader_module(comp_code);
+
+    // the set0_Instances layout holds the transforms, the per-mesh draws, and the visible instance list, all storage buffers used in the compute shader:
+    {
+        std::array< VkDescriptorSetLayoutBinding, 3 > Bindings
+        {
+            VkDescriptorSetLayoutBinding
+            {
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding
+            {
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding
+            {
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+        };
+
+        VkDescriptorSetLayoutCreateInfo CreateInfo
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(Bindings.size()),
+            .pBindings = Bindings.data(),
+        };
+
+        VK( vkCreateDescriptorSetLayout(rtg.device, &CreateInfo, nullptr, &Set0_Instances) );
+    }
+
+    {
+        VkPushConstantRange Range
+        {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push),
+        };
+
+        VkPipelineLayoutCreateInfo CreateInfo
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &Set0_Instances,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &Range,
+        };
+
+        VK( vkCreatePipelineLayout(rtg.device, &CreateInfo, nullptr, &Layout) );
+    }
+
+    {
+        VkComputePipelineCreateInfo CreateInfo
+        {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = Comp_Module,
+                .pName = "main",
+            },
+            .layout = Layout,
+        };
+
+        VK( vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &CreateInfo, nullptr, &Handle) );
+    }
+
+    // the module is no longer needed once the pipeline exists:
+    vkDestroyShaderModule(rtg.device, Comp_Module, nullptr);
+}
+
+void Tutorial::CullPipeline::Destroy(RTG &rtg)
+{
+    if (Set0_Instances != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, Set0_Instances, nullptr);
+        Set0_Instances = VK_NULL_HANDLE;
+    }
+
+    if (Layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(rtg.device, Layout, nullptr);
+        Layout = VK_NULL_HANDLE;
+    }
+
+    if (Handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, Handle, nullptr);
+        Handle = VK_NULL_HANDLE;
+    }
+}
@@ -3,6 +3,9 @@
 
 #include "Helpers.hpp"
 
+#include <algorithm>
+#include <iostream>
+
 static uint32_t vert_code[] =
 #include "spv/objects.vert.inl"
 ;
@@ -11,10 +14,26 @@ static uint32_t frag_code[] =
 #include "spv/objects.frag.inl"
 ;
 
+// (for devices without descriptor indexing: samples the one texture bound for the draw)
+static uint32_t fallback_frag_code[] =
+#include "spv/objects-fallback.frag.inl"
+;
+
 void Tutorial::ObjectsPipeline::Create(RTG &rtg, VkRenderPass RenderPass, uint32_t Subpass)
 {
+    // the texture array needs descriptor indexing; without it, each draw binds its own texture instead:
+    {
+        VkPhysicalDeviceVulkan12Features const &Features = rtg.enabled_vulkan12_features;
+        Bindless = Features.runtimeDescriptorArray && Features.shaderSampledImageArrayNonUniformIndexing
+            && Features.descriptorBindingPartiallyBound && Features.descriptorBindingVariableDescriptorCount;
+        if (!Bindless)
+        {
+            std::cerr << "No descriptor indexing on this device; binding object textures per draw instead of as one array." << std::endl;
+        }
+    }
+
     VkShaderModule Vert_Module = rtg.helpers.create_shader_module(vert_code);
-    VkShaderModule Frag_Module = rtg.helpers.create_shader_module(frag_code);
+    VkShaderModule Frag_Module = Bindless ? rtg.helpers.create_shader_module(frag_code) : rtg.helpers.create_shader_module(fallback_frag_code);
 
     // the set0_World layout holds world info in a uniform buffer used in the fragment shader:
     {
@@ -42,7 +61,8 @@ void Tutorial::ObjectsPipeline::Create(RTG &rtg, VkRenderPass RenderPass, uint32
     // the set1_Transforms layout holds an array of Transform structures in a storage buffer used in the vertex shader:
     {
         //the set1_Transforms layout holds an array of Transform structures in a storage buffer used in the vertex shader:
-        std::array< VkDescriptorSetLayoutBinding, 1 > Bindings
+        // (and the list of visible instances' transform indices, which gl_InstanceIndex looks up first)
+        std::array< VkDescriptorSetLayoutBinding, 2 > Bindings
         {
 			VkDescriptorSetLayoutBinding
             {
@@ -51,6 +71,13 @@ void Tutorial::ObjectsPipeline::Create(RTG &rtg, VkRenderPass RenderPass, uint32
 				.descriptorCount = 1,
 				.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
 			},
+			VkDescriptorSetLayoutBinding
+            {
+				.binding = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+			},
 		};
 		
 		VkDescriptorSetLayoutCreateInfo CreateInfo
@@ -63,7 +90,51 @@ void Tutorial::ObjectsPipeline::Create(RTG &rtg, VkRenderPass RenderPass, uint32
 		VK( vkCreateDescriptorSetLayout(rtg.device, &CreateInfo, nullptr, &Set1_Transforms) );
     }
 
-    // the set2_TEXTURE layout has a single descriptor for a sampler2D used in the fragment shader:
+    // the set2_TEXTURE layout is a (bindless) array of every texture, as sampler2Ds used in the fragment shader;
+    // instances pick theirs by index (Transform::TEXTURE), so one set stays bound for all draws:
+    if (Bindless)
+    {
+        // the array's size is set when the set is allocated; this is only an upper bound:
+        VkPhysicalDeviceProperties Properties;
+        vkGetPhysicalDeviceProperties(rtg.physical_device, &Properties);
+        MaxTextures = std::min({ MaxTextures,
+            Properties.limits.maxPerStageDescriptorSamplers, Properties.limits.maxPerStageDescriptorSampledImages,
+            Properties.limits.maxDescriptorSetSamplers, Properties.limits.maxDescriptorSetSampledImages });
+
+        std::array< VkDescriptorSetLayoutBinding, 1 > Bindings
+        {
+            VkDescriptorSetLayoutBinding
+            {
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = MaxTextures,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+            },
+        };
+
+        std::array< VkDescriptorBindingFlags, 1 > BindingFlags
+        {
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
+        };
+        VkDescriptorSetLayoutBindingFlagsCreateInfo FlagsInfo
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = uint32_t(BindingFlags.size()),
+            .pBindingFlags = BindingFlags.data(),
+        };
+
+        VkDescriptorSetLayoutCreateInfo CreateInfo
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &FlagsInfo,
+            .bindingCount = uint32_t(Bindings.size()),
+            .pBindings = Bindings.data(),
+        };
+
+        VK( vkCreateDescriptorSetLayout(rtg.device, &CreateInfo, nullptr, &Set2_TEXTURE) );
+    }
+    // ...or, without descriptor indexing, a single descriptor for a sampler2D used in the fragment shader:
+    else
     {
         std::array< VkDescriptorSetLayoutBinding, 1 > Bindings
         {
@@ -4,19 +4,180 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include "ImageLoader.hpp"
+#include "KTX2.hpp"
+#include "MeshOptimizer.hpp"
 
 
 const Tutorial::Vec2 Tutorial::Vec2::Zero{0.0f, 0.0f};
 const Tutorial::Vec2 Tutorial::Vec2::One{1.0f, 1.0f};
 
-Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_) 
+static VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
 {
+	return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+bool Tutorial::Configuration::ParseArg(int argc, char **argv, int &argi)
+{
+	std::string Arg = argv[argi];
+	if (Arg == "--benchmark")
+	{
+		Benchmark = true;
+	}
+	else if (Arg == "--fixed-dt")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--fixed-dt requires a parameter (a timestep in seconds).");
+		argi += 1;
+		std::string Value = argv[argi];
+		size_t Used = 0;
+		try
+		{
+			FixedDt = std::stof(Value, &Used);
+		}
+		catch (std::exception &)
+		{
+			Used = 0;
+		}
+		if (Used != Value.size() || !(FixedDt > 0.0f))
+		{
+			throw std::runtime_error("--fixed-dt should be a positive number of seconds, got '" + Value + "'.");
+		}
+	}
+	else if (Arg == "--pattern")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--pattern requires a parameter (none, x, grid, or blackhole).");
+		argi += 1;
+		std::string Value = argv[argi];
+		if (Value == "none") Pattern = None;
+		else if (Value == "x") Pattern = X;
+		else if (Value == "grid") Pattern = Grid;
+		else if (Value == "blackhole") Pattern = BlackHole;
+		else throw std::runtime_error("--pattern should be one of none, x, grid, or blackhole; got '" + Value + "'.");
+	}
+	else if (Arg == "--csv")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--csv requires a parameter (a file name).");
+		argi += 1;
+		CSV = argv[argi];
+	}
+	else if (Arg == "--record")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--record requires a parameter (a file name).");
+		argi += 1;
+		Record = argv[argi];
+	}
+	else if (Arg == "--replay")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--replay requires a parameter (a file name).");
+		argi += 1;
+		Replay = argv[argi];
+	}
+	else if (Arg == "--staged-uploads")
+	{
+		StagedUploads = true;
+	}
+	else if (Arg == "--screenshot")
+	{
+		if (argi + 2 >= argc) throw std::runtime_error("--screenshot requires two parameters (a frame number and a file name).");
+		argi += 1;
+		std::string Value = argv[argi];
+		if (Value.empty() || Value.find_first_not_of("0123456789") != std::string::npos || std::stoull(Value) == 0)
+		{
+			throw std::runtime_error("--screenshot frame should be a positive integer, got '" + Value + "'.");
+		}
+		ScreenshotFrame = std::stoull(Value);
+		argi += 1;
+		ScreenshotFile = argv[argi];
+	}
+	else if (Arg == "--no-mipmaps")
+	{
+		Mipmaps = false;
+	}
+	else if (Arg == "--no-compressed-textures")
+	{
+		CompressedTextures = false;
+	}
+	else if (Arg == "--no-texture-cache")
+	{
+		TextureCache = false;
+	}
+	else if (Arg == "--culling")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--culling requires a parameter (gpu, cpu, or none).");
+		argi += 1;
+		std::string Value = argv[argi];
+		if (Value == "gpu") Culling = GPUCulling;
+		else if (Value == "cpu") Culling = CPUCulling;
+		else if (Value == "none") Culling = NoCulling;
+		else throw std::runtime_error("--culling should be one of gpu, cpu, or none; got '" + Value + "'.");
+	}
+	else if (Arg == "--anisotropy")
+	{
+		if (argi + 1 >= argc) throw std::runtime_error("--anisotropy requires a parameter (a maximum anisotropy).");
+		argi += 1;
+		std::string Value = argv[argi];
+		size_t Used = 0;
+		try
+		{
+			Anisotropy = std::stof(Value, &Used);
+		}
+		catch (std::exception &)
+		{
+			Used = 0;
+		}
+		if (Used != Value.size() || !(Anisotropy >= 1.0f))
+		{
+			throw std::runtime_error("--anisotropy should be a number >= 1, got '" + Value + "'.");
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+void Tutorial::Configuration::Usage(std::function< void(const char *, const char *) > const &callback)
+{
+	callback("--benchmark", "Deterministic benchmark: fixed timestep, scripted camera, input ignored.");
+	callback("--fixed-dt <seconds>", "Timestep used by --benchmark (default 1/60).");
+	callback("--pattern <none|x|grid|blackhole>", "Select the line pattern (and which pipelines run).");
+	callback("--csv <file>", "Write per-frame CPU and GPU timings to <file> at exit.");
+	callback("--record <file>", "Record input events (with frame numbers) to <file>.");
+	callback("--replay <file>", "Replay input events from <file> at the frames they were recorded.");
+	callback("--staged-uploads", "Copy per-frame data from a staging buffer even if the GPU has host-visible device-local memory.");
+	callback("--screenshot <frame> <file.ppm>", "Save the image rendered in frame <frame> (counting from 1) to <file.ppm>.");
+	callback("--no-mipmaps", "Give textures a single mip level and sample them with nearest filtering.");
+	callback("--no-compressed-textures", "Decode textures from their original images even if block-compressed .ktx2 versions exist.");
+	callback("--no-texture-cache", "Decode textures without reading or writing the decoded-texture cache.");
+	callback("--culling <gpu|cpu|none>", "Frustum cull objects in a compute pass (default), on the CPU with SSE, or not at all.");
+	callback("--anisotropy <N>", "Maximum anisotropy for texture sampling (default 16, clamped to the device limit; 1 disables).");
+}
+
+Tutorial::Tutorial(RTG &rtg_, Configuration const &configuration_) : rtg(rtg_), configuration(configuration_)
+{
+	if (configuration.Pattern)
+	{
+		PatternType = *configuration.Pattern;
+	}
+
+	if (!configuration.Replay.empty())
+	{
+		Replay = std::make_unique< InputReplay >(configuration.Replay);
+	}
+	if (!configuration.Record.empty())
+	{
+		Recorder = std::make_unique< InputRecorder >(configuration.Record);
+	}
+
 	// select a depth format:
 	// (at least one of these two must be supported, according to the spec; but neither are required)
 	depth_format = rtg.helpers.find_image_format
@@ -52,7 +213,8 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				// headless images are never presented, so leave them ready to be read back instead:
+				.finalLayout = rtg.configuration.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
 			},
 			VkAttachmentDescription
 			{
@@ -129,9 +291,44 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		VK( vkCreateRenderPass(rtg.device, &CreateInfo, nullptr, &render_pass));
 	}
 
+	// check whether the graphics queue can write timestamps:
+	{
+		uint32_t Count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(rtg.physical_device, &Count, nullptr);
+		std::vector< VkQueueFamilyProperties > QueueFamilies(Count);
+		vkGetPhysicalDeviceQueueFamilyProperties(rtg.physical_device, &Count, QueueFamilies.data());
+
+		uint32_t ValidBits = QueueFamilies[rtg.graphics_queue_family.value()].timestampValidBits;
+		if (ValidBits != 0)
+		{
+			VkPhysicalDeviceProperties Properties;
+			vkGetPhysicalDeviceProperties(rtg.physical_device, &Properties);
+			TimestampPeriod = Properties.limits.timestampPeriod;
+			TimestampMask = (ValidBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << ValidBits) - 1);
+		}
+		else
+		{
+			std::cerr << "Graphics queue doesn't support timestamps; GPU pass timing is disabled." << std::endl;
+		}
+	}
+
+	// layout of the per-workspace FrameData buffer (descriptor offsets must respect device alignment limits):
+	{
+		VkPhysicalDeviceProperties Properties;
+		vkGetPhysicalDeviceProperties(rtg.physical_device, &Properties);
+		UniformAlignment = Properties.limits.minUniformBufferOffsetAlignment;
+		StorageAlignment = Properties.limits.minStorageBufferOffsetAlignment;
+		MaxStorageRange = Properties.limits.maxStorageBufferRange;
+
+		CameraOffset = 0;
+		WorldOffset = AlignUp(CameraOffset + sizeof(LinesPipeline::Camera), UniformAlignment);
+		TransformsOffset = AlignUp(WorldOffset + sizeof(ObjectsPipeline::World), StorageAlignment);
+	}
+
 	BackgroundPipeline.Create(rtg, render_pass, 0);
 	LinesPipeline.Create(rtg, render_pass, 0);
 	ObjectsPipeline.Create(rtg, render_pass, 0);
+	CullPipeline.Create(rtg);
 
 	// create descriptor pool:
 	{
@@ -147,7 +344,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			VkDescriptorPoolSize
 			{
 				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				.descriptorCount = 1 * PerWorkspace,	// one descriptor per set, one set per workspace
+				.descriptorCount = 5 * PerWorkspace,	// two descriptors in the Transforms set and three in the Cull set, per workspace
 			},
 		};
 
@@ -155,7 +352,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		{
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 			.flags = 0, // because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, *can't* free individual descriptors allocated from this pool
-			.maxSets = 3 * PerWorkspace, // three set per workspace
+			.maxSets = 4 * PerWorkspace, // four sets per workspace
 			.poolSizeCount = uint32_t(PoolSizes.size()),
 			.pPoolSizes = PoolSizes.data(),
 		};
@@ -179,24 +376,19 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			VK( vkAllocateCommandBuffers(rtg.device, &AllocInfo, &workspace.command_buffer));
 		}
 
-		workspace.CameraSrc = rtg.helpers.create_buffer
-		(
-			sizeof(LinesPipeline::Camera),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,		// going to have GPU copy from this memory
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT 
-			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,	// host-visible memory, coherent (no special sync needed)
-			Helpers::Mapped 						// get a pointer to the memory
-		);
+		// create timestamp queries (a begin and end per pass):
+		if (TimestampPeriod != 0.0f)
+		{
+			VkQueryPoolCreateInfo CreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				.queryType = VK_QUERY_TYPE_TIMESTAMP,
+				.queryCount = 2 * GPUPassCount,
+			};
+
+			VK( vkCreateQueryPool(rtg.device, &CreateInfo, nullptr, &workspace.TimestampQueries));
+		}
 
-		workspace.Camera = rtg.helpers.create_buffer
-		(
-			sizeof(LinesPipeline::Camera),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT 
-			| VK_BUFFER_USAGE_TRANSFER_DST_BIT, 	// going to use as a uniform buffer, also going to have GPU copy into this memory
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 	// GPU-local memory
-			Helpers::Unmapped 						// don't get a pointer to the memory
-		);
-		
 		// allocate descriptor set for Camera descriptor
 		{
 			VkDescriptorSetAllocateInfo AllocInfo
@@ -210,21 +402,6 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &workspace.CameraDescriptors) );
 		}
 
-		workspace.WorldSrc = rtg.helpers.create_buffer
-		(
-			sizeof(ObjectsPipeline::World),
-			VK_BUFFER_USAGE_2_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			Helpers::Mapped
-		);
-		workspace.World = rtg.helpers.create_buffer
-		(
-			sizeof(ObjectsPipeline::World),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			Helpers::Unmapped
-		);
-
 		{
 			// Allocate descriptor set for world descriptor
 			VkDescriptorSetAllocateInfo AllocInfo
@@ -236,8 +413,6 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			};
 
 			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &workspace.WorldDescriptors));
-			
-			//NOTE: will actually fill in this descriptor set just a bit lower
 		}
 
 		// allocate descriptor set for Transforms descriptor
@@ -251,128 +426,202 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 			};
 
 			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &workspace.TransformDescriptors));
-			// NOTE: will fill in this descriptor set in render when buffers are [re-]allocated
 		}
 
-		 // point descriptor to Camera buffer:
+		// allocate descriptor set for the cull pass
 		{
-			VkDescriptorBufferInfo CameraInfo
+			VkDescriptorSetAllocateInfo AllocInfo
 			{
-				.buffer = workspace.Camera.handle,
-				.offset = 0,
-				.range = workspace.Camera.size,
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = DescriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &CullPipeline.Set0_Instances,
 			};
 
-			VkDescriptorBufferInfo WorldInfo
-			{
-				.buffer = workspace.World.handle,
-				.offset = 0,
-				.range = workspace.World.size,
-			};
+			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &workspace.CullDescriptors));
+		}
 
-			std::array< VkWriteDescriptorSet, 2 > Writes
+		// create per-frame buffers (which also fills in the descriptor sets above):
+		ReserveFrameData(workspace, 64 * 1024);
+	}
+
+	// Create Object Vertices (shared by all workspaces)
+	{
+		Helpers::TagScope Tag(rtg.helpers, Helpers::VertexMemory);
+		std::vector< PosNorTexVertex > Vertices;
+		// Create Quadrilateral:
+		InstantializePlane(Vertices);
+
+		// Create Torus
+		InstantializeTorus(Vertices);
+
+		// (for frustum culling)
+		ComputeBounds(Vertices, PlaneVertices);
+		ComputeBounds(Vertices, TorusVertices);
+
+		// weld each mesh's triangle list into shared vertices + indices, with triangles ordered for the post-transform cache:
+		// (afterward, each mesh's first/count is its range of ObjectIndices)
+		std::vector< PosNorTexVertex > IndexedVertices;
+		std::vector< uint32_t > Indices;
+		for (ObjectVerticesInfo *Mesh : { &PlaneVertices, &TorusVertices })
+		{
+			std::vector< PosNorTexVertex > Triangles(Vertices.begin() + Mesh->first, Vertices.begin() + Mesh->first + Mesh->count);
+			std::vector< PosNorTexVertex > MeshVertices;
+			std::vector< uint32_t > MeshIndices;
+			optimize_mesh(Triangles, &MeshVertices, &MeshIndices);
+
+			if (rtg.configuration.debug)
 			{
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.CameraDescriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-					.pBufferInfo = &CameraInfo,
-				},
-				VkWriteDescriptorSet{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.WorldDescriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-					.pBufferInfo = &WorldInfo,
-				},
-			};
+				std::cout << "Mesh: " << Triangles.size() << " vertices welded to " << MeshVertices.size()
+				          << "; vertex shader invocations per triangle " << acmr(MeshIndices, 16) << " (from 3 unindexed)." << std::endl;
+			}
 
-			vkUpdateDescriptorSets
-			(
-				rtg.device, 				// device
-				uint32_t(Writes.size()), 	// descriptorWriteCount
-				Writes.data(), 				// pDescriptorWrites
-				0, 							// descriptorCopyCount
-				nullptr 					// pDescriptorCopies
-			);
+			uint32_t Base = uint32_t(IndexedVertices.size());
+			Mesh->first = uint32_t(Indices.size());
+			Mesh->count = uint32_t(MeshIndices.size());
+			IndexedVertices.insert(IndexedVertices.end(), MeshVertices.begin(), MeshVertices.end());
+			for (uint32_t Index : MeshIndices)
+			{
+				Indices.emplace_back(Base + Index);
+			}
 		}
 
-		// Create Object Vertices
-		{
-			std::vector< PosNorTexVertex > Vertices;
-			// Create Quadrilateral:
-			InstantializePlane(Vertices);
+		size_t Bytes = IndexedVertices.size() * sizeof(IndexedVertices[0]);
 
-			// Create Torus
-			InstantializeTorus(Vertices);
+		ObjectVertices = rtg.helpers.create_buffer
+		(
+			Bytes,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped
+		);
 
-			size_t Bytes = Vertices.size() * sizeof(Vertices[0]);
+		// copy data to buffer (submitted along with the textures, below)
+		rtg.helpers.queue_buffer_upload(IndexedVertices.data(), Bytes, ObjectVertices);
 
-			ObjectVertices = rtg.helpers.create_buffer
-			(
-				Bytes,
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				Helpers::Unmapped
-			);
+		size_t IndexBytes = Indices.size() * sizeof(Indices[0]);
 
-			// copy data to buffer
-			rtg.helpers.transfer_to_buffer(Vertices.data(), Bytes, ObjectVertices);
-		}
+		ObjectIndices = rtg.helpers.create_buffer
+		(
+			IndexBytes,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped
+		);
+
+		rtg.helpers.queue_buffer_upload(Indices.data(), IndexBytes, ObjectIndices);
 	}
 
 	 // make some textures
 	{
+		Helpers::TagScope Tag(rtg.helpers, Helpers::TextureMemory);
 		Textures.reserve(2);
 
-		// First Texture
+		// with mipmaps, level 0 is uploaded and the other levels are blitted from it (so textures are also transfer sources):
+		VkImageUsageFlags TextureUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (configuration.Mipmaps) TextureUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		auto TextureMips = [&](int Width, int Height)
 		{
-			int Width,Height;
-			std::vector< uint32_t > Data;
-			Data = ImageLoader::Load("../Textures/YellowPaint.jpg", Width, Height);
-			assert(Data.size() == Width*Height);
+			return configuration.Mipmaps ? Helpers::mip_count(VkExtent2D{ .width = uint32_t(Width), .height = uint32_t(Height) }) : 1u;
+		};
+
+		struct TextureFile
+		{
+			char const *Path;
+			VkFormat Format;
+			char const *Compressed; // block-compressed version, with its mip chain (see the KTX2 rules in Maekfile.js)
+		};
+		std::array< TextureFile, 2 > TextureFiles
+		{{
+			{ "../Textures/YellowPaint.jpg", VK_FORMAT_R8G8B8A8_UNORM, "../Textures/YellowPaint.ktx2" }, // linearly-encoded 8-bit RGBA
+			{ "../Textures/WaterMask.png", VK_FORMAT_R8G8B8A8_SRGB, "../Textures/WaterMask.ktx2" }, // SRGB-encoded 8-bit RGBA
+		}};
+
+		// make a place for each texture to live on the GPU, and reserve staging memory for its pixels:
+		std::vector< ImageLoader::DecodeTarget > Targets;
+		Targets.reserve(TextureFiles.size());
+		for (TextureFile const &File : TextureFiles)
+		{
+			// if there's a compressed version the device can sample, upload its blocks (and stored mips) as-is:
+			if (configuration.CompressedTextures && rtg.enabled_features.textureCompressionBC && std::filesystem::exists(File.Compressed))
+			{
+				std::optional< KTX2Texture > Compressed;
+				try
+				{
+					Compressed.emplace(File.Compressed);
+				}
+				catch (std::exception &E)
+				{
+					std::cerr << E.what() << " Using '" << File.Path << "' instead." << std::endl;
+				}
+
+				if (Compressed)
+				{
+					uint32_t Levels = (configuration.Mipmaps ? uint32_t(Compressed->levels.size()) : 1u);
+					Textures.emplace_back(rtg.helpers.create_image
+					(
+						VkExtent2D{ .width = Compressed->width, .height = Compressed->height },
+						Compressed->format, // (including whether it is sRGB-encoded)
+						VK_IMAGE_TILING_OPTIMAL,
+						VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // (no blits)
+						VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						Helpers::Unmapped,
+						Levels
+					));
+					size_t Bytes = Compressed->levels_size(Levels);
+					Compressed->read_levels(Levels, rtg.helpers.queue_image_levels_upload_into(Textures.back(), Bytes));
+					continue;
+				}
+			}
+
+			// if this exact file has been decoded before, upload its cached texels (mapped from disk) without decoding:
+			std::string CachePath = (configuration.TextureCache ? ImageLoader::CachePath(Configuration::TextureCacheDirectory, File.Path) : "");
+			CachedImage Cached;
+			if (!CachePath.empty() && ImageLoader::LoadCached(CachePath, Cached))
+			{
+				Textures.emplace_back(rtg.helpers.create_image
+				(
+					VkExtent2D{ .width = (uint32_t)Cached.Width , .height = (uint32_t)Cached.Height },
+					File.Format,
+					VK_IMAGE_TILING_OPTIMAL,
+					TextureUsage,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					Helpers::Unmapped,
+					TextureMips(Cached.Width, Cached.Height)
+				));
+				rtg.helpers.queue_image_upload(Cached.Data(), Cached.Size(), Textures.back());
+				continue;
+			}
+
+			int Width = 1, Height = 1;
+			ImageLoader::Info(File.Path, Width, Height);
 
-			// make a place for the texture to live on the GPU
 			Textures.emplace_back(rtg.helpers.create_image
 			(
 				VkExtent2D{ .width = (uint32_t)Width , .height = (uint32_t)Height }, // size of image
-				VK_FORMAT_R8G8B8A8_UNORM, // how to interpret image data (in this case, linearly-encoded 8-bit RGBA)
+				File.Format,
 				VK_IMAGE_TILING_OPTIMAL,
-				VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
+				TextureUsage, // will sample and upload
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // should be device-local
-				Helpers::Unmapped
+				Helpers::Unmapped,
+				TextureMips(Width, Height)
 			));
 
-			// transfer data
-			rtg.helpers.transfer_to_image(Data.data(), sizeof(Data[0]) * Data.size(), Textures.back());
+			size_t Bytes = size_t(Width) * Height * 4;
+			Targets.emplace_back(ImageLoader::DecodeTarget{ File.Path, Width, Height, rtg.helpers.queue_image_upload_into(Textures.back(), Bytes), CachePath });
 		}
-
-		// Texture 1 will be a classic 'xor' texture
+		if (configuration.TextureCache && !Targets.empty())
 		{
-			int Width,Height;
-			std::vector< uint32_t > Data;
-			Data = ImageLoader::Load("../Textures/WaterMask.png", Width, Height);
-			assert(Data.size() == Width*Height);
+			std::error_code Error;
+			std::filesystem::create_directories(Configuration::TextureCacheDirectory, Error);
+		}
 
-			// Make a place for the texture to live on the GPU:
-			Textures.emplace_back(rtg.helpers.create_image
-			(
-			VkExtent2D{ .width = (uint32_t)Width  , .height = (uint32_t)Height }, // size of image
-			VK_FORMAT_R8G8B8A8_SRGB, 	// how to interpret image data (in this case, SRGB-encoded 8-bit RGBA)
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 	// will sample and upload
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 							// should be device-local
-			Helpers::Unmapped
-			));
+		// decode all the texture files at once, spread over the CPU's cores, straight into staging memory:
+		ImageLoader::DecodeInto(Targets);
 
-			// Transfer data:
-			rtg.helpers.transfer_to_image(Data.data(), sizeof(Data[0]) * Data.size(), Textures.back());
-		}
+		// ObjectVertices and all textures go to the GPU in one submit;
+		// nothing waits for it here -- the first frame's render acquires it (see Helpers::acquire_uploads):
+		SceneUploads = rtg.helpers.submit_uploads();
 	}
 
 	 // make image views for the textures
@@ -392,7 +641,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 				{
 					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 					.baseMipLevel = 0,
-					.levelCount = 1,
+					.levelCount = Image.mip_levels,
 					.baseArrayLayer = 0,
 					.layerCount = 1,
 				},
@@ -408,23 +657,33 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 
 	 // make a sampler for the textures
 	{
+		// trilinear (plus anisotropic, if the device can) when there are mips, so distant surfaces read small levels:
+		float MaxAnisotropy = 1.0f;
+		if (configuration.Mipmaps && rtg.enabled_features.samplerAnisotropy)
+		{
+			VkPhysicalDeviceProperties Properties;
+			vkGetPhysicalDeviceProperties(rtg.physical_device, &Properties);
+			MaxAnisotropy = std::min(configuration.Anisotropy, Properties.limits.maxSamplerAnisotropy);
+		}
+		VkFilter Filter = (configuration.Mipmaps ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+
 		VkSamplerCreateInfo CreateInfo
 		{
 			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
 			.flags = 0,
-			.magFilter = VK_FILTER_NEAREST,
-			.minFilter = VK_FILTER_NEAREST,
-			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.magFilter = Filter,
+			.minFilter = Filter,
+			.mipmapMode = (configuration.Mipmaps ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST),
 			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
 			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
 			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
 			.mipLodBias = 0.0f,
-			.anisotropyEnable = VK_FALSE,
-			.maxAnisotropy = 0.0f, 				// doesn't matter if anisotropy isn't enabled
+			.anisotropyEnable = (MaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE),
+			.maxAnisotropy = MaxAnisotropy, 	// doesn't matter if anisotropy isn't enabled
 			.compareEnable = VK_FALSE,
 			.compareOp = VK_COMPARE_OP_ALWAYS, // doesn't matter if compare isn't enabled
 			.minLod = 0.0f,
-			.maxLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE, 		// (images without mips only have level 0 anyway)
 			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
 			.unnormalizedCoordinates = VK_FALSE,
 		};
@@ -432,15 +691,19 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 	}
 
 	// create the texture descriptor pool	
+	uint32_t TextureCount = uint32_t(Textures.size());
+	if (ObjectsPipeline.Bindless && TextureCount > ObjectsPipeline.MaxTextures)
 	{
-		uint32_t PerTexture = uint32_t(Textures.size());
+		throw std::runtime_error("Have " + std::to_string(TextureCount) + " textures, but the device only allows " + std::to_string(ObjectsPipeline.MaxTextures) + " in the texture array.");
+	}
 
+	{
 		std::array< VkDescriptorPoolSize, 1 > PoolSizes
 		{
 			VkDescriptorPoolSize
 			{
 				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1 * 1 * PerTexture,	 // one descriptor per set, one set per texture
+				.descriptorCount = std::max(TextureCount, 1u),	 // one descriptor per texture (all in one set, if bindless)
 			}
 		};
 
@@ -448,7 +711,7 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		{
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 			.flags = 0, 	// because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, *can't* free individual descriptors allocated from this pool
-			.maxSets = 1 * PerTexture, 	// one set per texture
+			.maxSets = ObjectsPipeline.Bindless ? 1 : std::max(TextureCount, 1u), 	// the texture array, or one set per texture
 			.poolSizeCount = uint32_t(PoolSizes.size()),
 			.pPoolSizes = PoolSizes.data(),
 		};
@@ -456,51 +719,91 @@ Tutorial::Tutorial(RTG &rtg_) : rtg(rtg_)
 		VK(vkCreateDescriptorPool(rtg.device, &CreateInfo, nullptr, &TextureDescriptorPool));
 	}
 
-	 // allocate and write the texture descriptor sets
+	 // allocate and write the texture descriptor set(s)
 	{
-		// allocate the descriptors (using the same alloc_info):
-		VkDescriptorSetAllocateInfo AllocInfo
-		{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = TextureDescriptorPool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &ObjectsPipeline.Set2_TEXTURE,
-		};
-
-		TextureDescriptors.assign(Textures.size(), VK_NULL_HANDLE);
-
-		for (VkDescriptorSet &DescriptorSet : TextureDescriptors)
-		{
-			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &DescriptorSet));
-		}
-		
-		// write descriptors for textures
 		std::vector< VkDescriptorImageInfo > Infos(Textures.size());
-		std::vector< VkWriteDescriptorSet > Writes(Textures.size());
-
-		for (Helpers::AllocatedImage const &Image : Textures)
+		for (size_t Index = 0; Index < Textures.size(); ++Index)
 		{
-			size_t Index = &Image - &Textures[0];
-
 			Infos[Index] = VkDescriptorImageInfo
 			{
 				.sampler = TextureSampler,
 				.imageView = TextureViews[Index],
 				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			};
-			Writes[Index] = VkWriteDescriptorSet
+		}
+
+		std::vector< VkWriteDescriptorSet > Writes;
+		if (ObjectsPipeline.Bindless)
+		{
+			// the array is sized to the textures actually loaded:
+			VkDescriptorSetVariableDescriptorCountAllocateInfo CountInfo
 			{
-				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-				.dstSet = TextureDescriptors[Index],
-				.dstBinding = 0,
-				.dstArrayElement = 0,
-				.descriptorCount = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.pImageInfo = &Infos[Index],
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+				.descriptorSetCount = 1,
+				.pDescriptorCounts = &TextureCount,
 			};
+			VkDescriptorSetAllocateInfo AllocInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.pNext = &CountInfo,
+				.descriptorPool = TextureDescriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &ObjectsPipeline.Set2_TEXTURE,
+			};
+			TextureDescriptors.assign(1, VK_NULL_HANDLE);
+			VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &TextureDescriptors[0]));
+
+			// (element i is texture i)
+			if (TextureCount != 0)
+			{
+				Writes.emplace_back(VkWriteDescriptorSet
+				{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = TextureDescriptors[0],
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = TextureCount,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.pImageInfo = Infos.data(),
+				});
+			}
+		}
+		else
+		{
+			// one set per texture, as before descriptor indexing:
+			VkDescriptorSetAllocateInfo AllocInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = TextureDescriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &ObjectsPipeline.Set2_TEXTURE,
+			};
+			TextureDescriptors.assign(Textures.size(), VK_NULL_HANDLE);
+			for (size_t Index = 0; Index < TextureDescriptors.size(); ++Index)
+			{
+				VK( vkAllocateDescriptorSets(rtg.device, &AllocInfo, &TextureDescriptors[Index]));
+				Writes.emplace_back(VkWriteDescriptorSet
+				{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = TextureDescriptors[Index],
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.pImageInfo = &Infos[Index],
+				});
+			}
 		}
 
-		vkUpdateDescriptorSets(rtg.device, uint32_t(Writes.size()), Writes.data(), 0, nullptr);
+		if (!Writes.empty())
+		{
+			vkUpdateDescriptorSets(rtg.device, uint32_t(Writes.size()), Writes.data(), 0, nullptr);
+		}
+	}
+
+	if (rtg.configuration.debug)
+	{
+		rtg.helpers.report_stats(std::cout);
 	}
 }
 
@@ -512,6 +815,33 @@ Tutorial::~Tutorial() {
 		std::cerr << "Failed to vkDeviceWaitIdle in Tutorial::~Tutorial [" << string_VkResult(result) << "]; continuing anyway." << std::endl;
 	}
 
+	// the device is idle, so any outstanding timestamps are ready:
+	for (Workspace &workspace : workspaces)
+	{
+		ReadTimestamps(workspace);
+	}
+
+	if (!configuration.CSV.empty())
+	{
+		CollectCPUTimings();
+		WriteTimingsCSV();
+	}
+
+	if (ScreenshotTicket != 0)
+	{
+		SaveScreenshot(true);
+	}
+
+	if (rtg.configuration.timing_report && TimestampPeriod != 0.0f)
+	{
+		std::cout << "GPU pass timing (average of last " << GPUTimingWindow << " frames that ran each pass):\n";
+		for (uint32_t Pass = 0; Pass < GPUPassCount; ++Pass)
+		{
+			std::cout << "  " << GPUPassNames[Pass] << ": " << GPUPassMilliseconds[Pass] << " ms\n";
+		}
+		std::cout.flush();
+	}
+
 	if(TextureDescriptorPool)
 	{
 		vkDestroyDescriptorPool(rtg.device, TextureDescriptorPool, nullptr);
@@ -541,6 +871,7 @@ Tutorial::~Tutorial() {
 	Textures.clear();
 
 	rtg.helpers.destroy_buffer(std::move(ObjectVertices));
+	rtg.helpers.destroy_buffer(std::move(ObjectIndices));
 
 	if (swapchain_depth_image.handle != VK_NULL_HANDLE) 
 	{
@@ -554,50 +885,29 @@ Tutorial::~Tutorial() {
 			vkFreeCommandBuffers(rtg.device, command_pool, 1, &workspace.command_buffer);
 			workspace.command_buffer = VK_NULL_HANDLE;
 		}
-		
-		if(workspace.LinesVerticesSrc.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.LinesVerticesSrc));
-		}
-		if(workspace.LinesVertices.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.LinesVertices));
-		}
 
-		if(workspace.CameraSrc.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.CameraSrc));
-		}
-		if(workspace.Camera.handle != VK_NULL_HANDLE)
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Camera));
-		}
-
-		if (workspace.WorldSrc.handle != VK_NULL_HANDLE) 
-		{
-			rtg.helpers.destroy_buffer(std::move(workspace.WorldSrc));
-		}
-		if (workspace.World.handle != VK_NULL_HANDLE) 
+		if(workspace.TimestampQueries != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.World));
+			vkDestroyQueryPool(rtg.device, workspace.TimestampQueries, nullptr);
+			workspace.TimestampQueries = VK_NULL_HANDLE;
 		}
-		//World_descriptors freed when pool is destroyed.
-
-		if(workspace.TransformsSrc.handle != VK_NULL_HANDLE)
+		
+		if(workspace.UploadArena.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.TransformsSrc));
+			rtg.helpers.destroy_buffer(std::move(workspace.UploadArena));
 		}
-		if(workspace.Transforms.handle != VK_NULL_HANDLE)
+		if(workspace.FrameData.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
+			rtg.helpers.destroy_buffer(std::move(workspace.FrameData));
 		}
-		// Transforms_descriptors freed when pool is destroyed.
+		// Camera, World, Transforms, and Cull descriptors freed when pool is destroyed.
 	}
 	workspaces.clear();
 
 	BackgroundPipeline.Destroy(rtg);
 	LinesPipeline.Destroy(rtg);
 	ObjectsPipeline.Destroy(rtg);
+	CullPipeline.Destroy(rtg);
 
 	if(DescriptorPool)
 	{
@@ -629,6 +939,7 @@ void Tutorial::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain)
 	}
 
 	// allocate depth image for framebuffers to share
+	Helpers::TagScope Tag(rtg.helpers, Helpers::SwapchainMemory);
 	swapchain_depth_image = rtg.helpers.create_image
 	(
 		swapchain.extent,
@@ -725,208 +1036,182 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		};
 		VK(vkBeginCommandBuffer(workspace.command_buffer, &begin_info));
 	}
+
+	// Take ownership of finished uploads (and, until they've arrived, the scene's own uploads):
+	std::vector< VkSemaphore > UploadWaits;
+	std::vector< VkPipelineStageFlags > UploadWaitStages;
+	rtg.helpers.acquire_uploads(workspace.command_buffer, render_params.workspace_available, &UploadWaits, &UploadWaitStages, SceneUploads);
+
+	// The workspace fence has signaled, so the timestamps from its previous frame are ready:
+	ReadTimestamps(workspace);
+	if (workspace.TimestampQueries != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(workspace.command_buffer, workspace.TimestampQueries, 0, 2 * GPUPassCount);
+		workspace.TimestampFrame = FrameCount - 1;
+	}
+
+	WriteTimestamp(workspace, UploadPass, false);
 	
-	// GPU commands here:
-	// Line Render Pipeline
+	// Upload per-frame data:
 	{
-		// Upload line vertices
-		if(!LinesVertices.empty())
+		// group instances by mesh: one indirect draw per mesh, whose instances get consecutive transforms starting at firstInstance
+		// (meshes are few, so a linear search for each instance's draw is cheaper than hashing)
+		// without bindless textures, each draw binds one texture, so instances are also grouped by texture
+		ObjectDraws.clear();
+		ObjectDrawTextures.clear();
+		ObjectDrawOf.resize(ObjectInstances.size());
+		for (size_t i = 0; i < ObjectInstances.size(); ++i)
+		{
+			ObjectVerticesInfo const &Vertices = ObjectInstances[i].Vertices;
+			uint32_t Texture = ObjectInstances[i].Texture;
+			uint32_t Draw = 0;
+			while (Draw < ObjectDraws.size() && !(ObjectDraws[Draw].Command.firstIndex == Vertices.first && ObjectDraws[Draw].Command.indexCount == Vertices.count
+				&& (ObjectsPipeline.Bindless || ObjectDrawTextures[Draw] == Texture)))
+			{
+				++Draw;
+			}
+			if (Draw == ObjectDraws.size())
+			{
+				if (!ObjectsPipeline.Bindless) ObjectDrawTextures.emplace_back(Texture);
+				ObjectDraws.emplace_back(CullPipeline::Draw{
+					.Command{
+						.indexCount = Vertices.count,
+						.instanceCount = 0,
+						.firstIndex = Vertices.first,
+						.vertexOffset = 0,
+						.firstInstance = 0,
+					},
+					.BOUNDS{ Vertices.Bounds.x, Vertices.Bounds.y, Vertices.Bounds.z, Vertices.Bounds.r },
+				});
+			}
+			ObjectDraws[Draw].Command.instanceCount += 1;
+			ObjectDrawOf[i] = Draw;
+		}
 		{
-			// [re-]allocate lines buffers if needed:
-			size_t NeededBytes = LinesVertices.size() * sizeof(LinesVertices[0]);
-			if(workspace.LinesVerticesSrc.handle == VK_NULL_HANDLE ||
-				workspace.LinesVerticesSrc.size < NeededBytes)
+			uint32_t FirstInstance = 0;
+			for (CullPipeline::Draw &Draw : ObjectDraws)
 			{
-				size_t NewBytes = ((NeededBytes + 4096) / 4096) * 4096;
-				if(workspace.LinesVerticesSrc.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.LinesVerticesSrc));
-				}
-				if(workspace.LinesVertices.handle)
-				{
-					rtg.helpers.destroy_buffer(std::move(workspace.LinesVertices));
-				}
-
-				workspace.LinesVerticesSrc = rtg.helpers.create_buffer
-				(
-					NewBytes,
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 											// going to have GPU copy from this memory
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-					Helpers::Mapped 															// get a pointer to the memory
-				);
-				workspace.LinesVertices = rtg.helpers.create_buffer
-				(
-					NewBytes,
-					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 	// going to use as vertex buffer, also going to have GPU into this memory
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 									// GPU-local memory
-					Helpers::Unmapped 														// don't get a pointer to the memory
-				);
-
-				std::cout << "Re-allocated lines buffers to " << NewBytes << " bytes." << std::endl;
+				Draw.Command.firstInstance = FirstInstance;
+				FirstInstance += Draw.Command.instanceCount;
 			}
+		}
 
-			assert(workspace.LinesVerticesSrc.size == workspace.LinesVertices.size);
-			assert(workspace.LinesVerticesSrc.size >= NeededBytes);
-
-			// Host-side copy into LinesVerticesSrc:
-			assert(workspace.LinesVerticesSrc.allocation.mapped);
-			std::memcpy(workspace.LinesVerticesSrc.allocation.data(), LinesVertices.data(), NeededBytes);
-
-			// Device-side copy from LinesVerticesSrc -> LineVertices
-			VkBufferCopy CopyRegion
-			{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = NeededBytes,
-			};
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.LinesVerticesSrc.handle, 
-							workspace.LinesVertices.handle, 1, &CopyRegion);
+		// the workspace fence has signaled, so the whole arena is free again:
+		size_t TransformsBytes = ObjectInstances.size() * sizeof(ObjectsPipeline::Transform);
+		size_t LinesBytes = LinesVertices.size() * sizeof(LinesVertices[0]);
+		size_t DrawsBytes = ObjectDraws.size() * sizeof(CullPipeline::Draw);
+		size_t VisibleBytes = ObjectInstances.size() * sizeof(uint32_t);
+		VkDeviceSize DrawsAlignment = std::max< VkDeviceSize >(StorageAlignment, 4); // (indirect draws need 4-byte alignment)
+		{
+			VkDeviceSize Bytes = AlignUp(TransformsOffset + TransformsBytes, 16) + LinesBytes;
+			Bytes = AlignUp(Bytes, DrawsAlignment) + DrawsBytes;
+			Bytes = AlignUp(Bytes, StorageAlignment) + VisibleBytes;
+			ReserveFrameData(workspace, Bytes);
 		}
-	}
+		workspace.UploadArenaUsed = 0;
+
+		VkDeviceSize Offset = 0;
 
-	// upload camera info:
-	{ 
+		// camera info:
 		LinesPipeline::Camera Camera
 		{
 			.CLIP_FROM_WORLD = CLIP_FROM_WORLD
 		};
-		assert(workspace.CameraSrc.size == sizeof(Camera));
+		std::memcpy(UploadArenaAlloc(workspace, sizeof(Camera), UniformAlignment, &Offset), &Camera, sizeof(Camera));
+		assert(Offset == CameraOffset);
 
-		// host-side copy into Camera_src:
-		memcpy(workspace.CameraSrc.allocation.data(), &Camera, sizeof(Camera));
+		// world info:
+		std::memcpy(UploadArenaAlloc(workspace, sizeof(World), UniformAlignment, &Offset), &World, sizeof(World));
+		assert(Offset == WorldOffset);
 
-		// add device-side copy from Camera_src -> Camera:
-		assert(workspace.CameraSrc.size == workspace.Camera.size);
-		VkBufferCopy CopyRegion
+		// object transforms, in draw order: (always reserved, so the descriptor offset never changes)
 		{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = workspace.CameraSrc.size,
-		};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.CameraSrc.handle, workspace.Camera.handle, 1, &CopyRegion);
-	}
-
-	// upload world info:
-	{
-		assert(workspace.CameraSrc.size == sizeof(World));
-
-		//host-side copy into World_src:
-		memcpy(workspace.WorldSrc.allocation.data(), &World, sizeof(World));
-
-		//add device-side copy from World_src -> World:
-		assert(workspace.WorldSrc.size == workspace.World.size);
-		VkBufferCopy CopyRegion
-		{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = workspace.WorldSrc.size,
-		};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.WorldSrc.handle, workspace.World.handle, 1, &CopyRegion);
-	}
-
-	if(!ObjectInstances.empty())
-	{
-		// upload object transforms:
-		size_t NeededBytes = ObjectInstances.size() * sizeof(ObjectsPipeline::Transform);
-		if(workspace.TransformsSrc.handle == VK_NULL_HANDLE ||
-			workspace.TransformsSrc.size < NeededBytes)
-		{
-			//round to next multiple of 4k to avoid re-allocating continuously if vertex count grows slowly:
-			size_t NewBytes = ((NeededBytes + 4096) / 4096) * 4096;
-			if(workspace.TransformsSrc.handle)
+			ObjectsPipeline::Transform *Out = reinterpret_cast< ObjectsPipeline::Transform * >(UploadArenaAlloc(workspace, TransformsBytes, StorageAlignment, &Offset)); // Strict aliasing violation, but it doesn't matter
+			assert(Offset == TransformsOffset);
+			ObjectDrawNext.resize(ObjectDraws.size());
+			for (size_t Draw = 0; Draw < ObjectDraws.size(); ++Draw)
 			{
-				rtg.helpers.destroy_buffer(std::move(workspace.TransformsSrc));
+				ObjectDrawNext[Draw] = ObjectDraws[Draw].Command.firstInstance;
 			}
-			if(workspace.Transforms.handle)
+			for (size_t i = 0; i < ObjectInstances.size(); ++i)
 			{
-				rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
+				ObjectsPipeline::Transform &Transform = Out[ObjectDrawNext[ObjectDrawOf[i]]++];
+				Transform = ObjectInstances[i].Transform;
+				Transform.TEXTURE = ObjectInstances[i].Texture;
+				Transform.DRAW = ObjectDrawOf[i];
 			}
-			workspace.TransformsSrc = rtg.helpers.create_buffer
-			(
-				NewBytes,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // going to have GPU copy from this memory
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
-				Helpers::Mapped // get a pointer to the memory
-			);
-			workspace.Transforms = rtg.helpers.create_buffer(
-				NewBytes,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // going to use as storage buffer, also going to have GPU into this memory
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // GPU-local memory
-				Helpers::Unmapped // don't get a pointer to the memory
-			);
+		}
 
-			// update the descriptor set:
-			VkDescriptorBufferInfo TransformInfo
-			{
-				.buffer = workspace.Transforms.handle,
-				.offset = 0,
-				.range = workspace.Transforms.size,
-			};
+		// line vertices:
+		void *LinesOut = UploadArenaAlloc(workspace, LinesBytes, 16, &workspace.LinesVerticesOffset);
+		if (LinesBytes != 0)
+		{
+			std::memcpy(LinesOut, LinesVertices.data(), LinesBytes);
+		}
 
-			std::array< VkWriteDescriptorSet, 1 > Writes
+		// object draws: (when culling on the GPU, instances are counted as they pass the test)
+		{
+			CullPipeline::Draw *Out = reinterpret_cast< CullPipeline::Draw * >(UploadArenaAlloc(workspace, DrawsBytes, DrawsAlignment, &workspace.ObjectDrawsOffset));
+			if (DrawsBytes != 0)
 			{
-				VkWriteDescriptorSet
+				std::memcpy(Out, ObjectDraws.data(), DrawsBytes);
+			}
+			if (CullOnGPU())
+			{
+				for (size_t Draw = 0; Draw < ObjectDraws.size(); ++Draw)
 				{
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.TransformDescriptors,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &TransformInfo,
-				},
-			};
-
-			vkUpdateDescriptorSets
-			(
-				rtg.device,
-				uint32_t(Writes.size()), Writes.data(), // descriptorWrites count, data
-				0, nullptr // descriptorCopies count, data
-			);
-
-			std::cout << "Re-allocated object transforms buffers to " << NewBytes << " bytes." << std::endl;
-
-			assert(workspace.TransformsSrc.size == workspace.Transforms.size);
-			assert(workspace.TransformsSrc.size >= NeededBytes);
+					Out[Draw].Command.instanceCount = 0;
+				}
+			}
+		}
 
-			// Copy Transform into TransformSrc
+		// visible instances: (written by the cull pass; otherwise every instance, in the transforms' order)
+		{
+			uint32_t *Out = reinterpret_cast< uint32_t * >(UploadArenaAlloc(workspace, VisibleBytes, StorageAlignment, &workspace.ObjectVisibleOffset));
+			if (!CullOnGPU())
 			{
-				assert(workspace.TransformsSrc.allocation.mapped);
-				ObjectsPipeline::Transform *Out = reinterpret_cast< ObjectsPipeline::Transform * >(workspace.TransformsSrc.allocation.data()); // Strict aliasing violation, but it doesn't matter
-				for (ObjectInstance const &Inst : ObjectInstances)
+				for (uint32_t i = 0; i < uint32_t(ObjectInstances.size()); ++i)
 				{
-					*Out = Inst.Transform;
-					++Out;
+					Out[i] = i;
 				}
 			}
+		}
 
-			// device-side copy from Transforms_src -> Transforms:
+		if (!ObjectDraws.empty())
+		{
+			WriteObjectDescriptors(workspace);
+		}
+
+		// one device-side copy for all of it:
+		// (host writes to coherent memory are visible to commands submitted afterward, so direct uploads need no copy or barrier)
+		if (!workspace.DirectUpload)
+		{
 			VkBufferCopy CopyRegion
 			{
 				.srcOffset = 0,
 				.dstOffset = 0,
-				.size = NeededBytes,
+				.size = workspace.UploadArenaUsed,
 			};
-
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.TransformsSrc.handle, workspace.Transforms.handle, 1, &CopyRegion);
+			vkCmdCopyBuffer(workspace.command_buffer, workspace.UploadArena.handle, workspace.FrameData.handle, 1, &CopyRegion);
 		}
 	}
 
 	// Memory Barrier
+	if (!workspace.DirectUpload)
 	{
 		// Memory barrier to make sure copies complete before rendering happens:
 		VkMemoryBarrier MemoryBarrier
 		{
 			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
 			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, // (the cull pass also counts into the draws)
 		};
 
 		vkCmdPipelineBarrier
 		(
 			workspace.command_buffer,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,  // srcStageMask
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, // dstStageMask
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask (culling, draws, vertices, uniforms, and storage)
 			0, 					// dependencyFlags
 			1, &MemoryBarrier,  // memoryBarriers (count, data)
 			0, nullptr,  		// bufferMemoryBarriers (count, data)
@@ -934,6 +1219,10 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		);
 	}
 
+	WriteTimestamp(workspace, UploadPass, true);
+
+	RenderCullPipeline(workspace);
+
 	// Render Pass
 	{
 		std::array<VkClearValue, 2> clear_values
@@ -988,20 +1277,45 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		vkCmdEndRenderPass(workspace.command_buffer);
 	}
 
+	// copy the finished image out for a screenshot, before it is presented:
+	if (configuration.ScreenshotFrame && *configuration.ScreenshotFrame == FrameCount && ScreenshotTicket == 0)
+	{
+		if (rtg.swapchain_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+		{
+			ScreenshotExtent = rtg.swapchain_extent;
+			ScreenshotFormat = rtg.surface_format.format;
+			ScreenshotTicket = rtg.helpers.record_image_readback
+			(
+				workspace.command_buffer,
+				rtg.swapchain_images[render_params.image_index],
+				ScreenshotFormat,
+				ScreenshotExtent,
+				rtg.configuration.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR // (render_pass's final layout)
+			);
+		}
+		else
+		{
+			std::cerr << "Swapchain images can't be copied from on this surface; not saving a screenshot." << std::endl;
+		}
+	}
+
 	// end recording:
 	VK(vkEndCommandBuffer(workspace.command_buffer));
 
 	//submit `workspace.command buffer` for the GPU to run:
 	{
-		std::array< VkSemaphore, 1 > WaitSemaphores
+		std::vector< VkSemaphore > WaitSemaphores
 		{
 			render_params.image_available
 		};
-		std::array< VkPipelineStageFlags, 1 > WaitStages
+		std::vector< VkPipelineStageFlags > WaitStages
 		{
 			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 		};
-		static_assert(WaitSemaphores.size() == WaitStages.size(), "every semaphore needs a stage");
+		// (uploads handed over from the transfer queue)
+		WaitSemaphores.insert(WaitSemaphores.end(), UploadWaits.begin(), UploadWaits.end());
+		WaitStages.insert(WaitStages.end(), UploadWaitStages.begin(), UploadWaitStages.end());
+		assert(WaitSemaphores.size() == WaitStages.size() && "every semaphore needs a stage");
 
 		
 		std::array< VkSemaphore, 1 > SignalSemaphores
@@ -1023,6 +1337,12 @@ void Tutorial::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		VK( vkQueueSubmit(rtg.graphics_queue, 1, &SubmitInfo, render_params.workspace_available));
 	}
 
+	// (a screenshot gets its own fence, after the submit above; the workspace fence is reset by the next frame before update() could see it)
+	if (ScreenshotTicket != 0)
+	{
+		rtg.helpers.submit_recorded_readbacks();
+	}
+
 	
 }
 
@@ -1049,8 +1369,80 @@ void Tutorial::RenderCustom(Workspace &workspace)
 	}
 }
 
+bool Tutorial::CullOnGPU() const
+{
+	// (culled draws have GPU-written instance counts, so they must be drawn indirectly, with a firstInstance)
+	return configuration.Culling == Configuration::GPUCulling && rtg.enabled_features.drawIndirectFirstInstance;
+}
+
+bool Tutorial::CullOnCPU() const
+{
+	// (also the fallback when the GPU's culling results couldn't be drawn)
+	return configuration.Culling == Configuration::CPUCulling || (configuration.Culling == Configuration::GPUCulling && !CullOnGPU());
+}
+
+void Tutorial::RenderCullPipeline(Workspace &workspace)
+{
+	if (!CullOnGPU() || ObjectInstances.empty()) return;
+
+	WriteTimestamp(workspace, CullPass, false);
+
+	vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, CullPipeline.Handle);
+
+	vkCmdBindDescriptorSets
+	(
+		workspace.command_buffer, 			// Command Buffer
+		VK_PIPELINE_BIND_POINT_COMPUTE, 	// Pipeline bind point
+		CullPipeline.Layout, 				// Pipeline Layout
+		0, 									// First Set
+		1, &workspace.CullDescriptors, 		// descriptor sets count, ptr
+		0, nullptr // DynamicOffsets Count, ptr
+	);
+
+	// frustum planes (the same ones the CPU path culls with):
+	{
+		Frustum View = Frustum::from_clip(CLIP_FROM_WORLD);
+
+		CullPipeline::Push Push
+		{
+			.INSTANCES = uint32_t(ObjectInstances.size()),
+		};
+		static_assert(sizeof(Push.PLANES) == sizeof(View.planes), "Frustum planes are packed like Push::PLANES.");
+		std::memcpy(Push.PLANES, View.planes.data(), sizeof(Push.PLANES));
+
+		vkCmdPushConstants(workspace.command_buffer, CullPipeline.Layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &Push);
+	}
+
+	vkCmdDispatch(workspace.command_buffer, (uint32_t(ObjectInstances.size()) + CullPipeline::WorkgroupSize - 1) / CullPipeline::WorkgroupSize, 1, 1);
+
+	// Memory barrier to make sure the culled draws and visible instances are written before drawing:
+	{
+		VkMemoryBarrier MemoryBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+		};
+
+		vkCmdPipelineBarrier
+		(
+			workspace.command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  // srcStageMask
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, // dstStageMask (draws, and visible instances)
+			0, 					// dependencyFlags
+			1, &MemoryBarrier,  // memoryBarriers (count, data)
+			0, nullptr,  		// bufferMemoryBarriers (count, data)
+			0, nullptr			// imageMemoryBarriers (count, data)
+		);
+	}
+
+	WriteTimestamp(workspace, CullPass, true);
+}
+
 void Tutorial::RenderBackgroundPipeline(Workspace &workspace)
 {
+	WriteTimestamp(workspace, BackgroundPass, false);
+
 	// draw with the background pipeline:
 	{
 		
@@ -1067,19 +1459,217 @@ void Tutorial::RenderBackgroundPipeline(Workspace &workspace)
 		}
 		vkCmdDraw(workspace.command_buffer, 3, 1, 0, 0);
 	}
+
+	WriteTimestamp(workspace, BackgroundPass, true);
+}
+
+void Tutorial::ReserveFrameData(Workspace &workspace, VkDeviceSize Bytes)
+{
+	if (workspace.FrameData.handle != VK_NULL_HANDLE && workspace.FrameData.size >= Bytes) return;
+
+	Helpers::TagScope Tag(rtg.helpers, Helpers::WorkspaceMemory);
+
+	// grow geometrically (to a multiple of 4k) so slowly-growing data doesn't re-allocate continuously:
+	VkDeviceSize NewBytes = AlignUp(std::max(Bytes, 2 * workspace.FrameData.size), 4096);
+	bool Growing = (workspace.FrameData.handle != VK_NULL_HANDLE);
+	if (workspace.UploadArena.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(workspace.UploadArena));
+	}
+	if (workspace.FrameData.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(workspace.FrameData));
+	}
+
+	VkBufferUsageFlags FrameDataUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;	// camera/world uniforms, transforms storage, lines vertices, object draws
+
+	// write straight into device-local memory if the hardware allows it (ReBAR / UMA):
+	if (!configuration.StagedUploads)
+	{
+		workspace.FrameData = rtg.helpers.create_host_writable_device_buffer(NewBytes, FrameDataUsage);
+	}
+	workspace.DirectUpload = (workspace.FrameData.handle != VK_NULL_HANDLE);
+
+	if (!workspace.DirectUpload)
+	{
+		workspace.UploadArena = rtg.helpers.create_buffer
+		(
+			NewBytes,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 											// going to have GPU copy from this memory
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host-visible memory, coherent (no special sync needed)
+			Helpers::Mapped 															// get a pointer to the memory
+		);
+		workspace.FrameData = rtg.helpers.create_buffer
+		(
+			NewBytes,
+			FrameDataUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 	// also going to have GPU copy into this memory
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 				// GPU-local memory
+			Helpers::Unmapped 									// don't get a pointer to the memory
+		);
+	}
+
+	if (!Growing && rtg.configuration.debug)
+	{
+		std::cout << "Per-frame data is " << (workspace.DirectUpload ? "written directly to host-visible device-local memory." : "staged and copied to device-local memory.") << std::endl;
+	}
+
+	// point descriptors at the new buffer:
+	VkDescriptorBufferInfo CameraInfo
+	{
+		.buffer = workspace.FrameData.handle,
+		.offset = CameraOffset,
+		.range = sizeof(LinesPipeline::Camera),
+	};
+	VkDescriptorBufferInfo WorldInfo
+	{
+		.buffer = workspace.FrameData.handle,
+		.offset = WorldOffset,
+		.range = sizeof(ObjectsPipeline::World),
+	};
+	VkDescriptorBufferInfo TransformInfo
+	{
+		.buffer = workspace.FrameData.handle,
+		.offset = TransformsOffset,
+		.range = std::min(workspace.FrameData.size - TransformsOffset, MaxStorageRange),
+	};
+
+	std::array< VkWriteDescriptorSet, 4 > Writes
+	{
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.CameraDescriptors,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.pBufferInfo = &CameraInfo,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.WorldDescriptors,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.pBufferInfo = &WorldInfo,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.TransformDescriptors,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &TransformInfo,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.CullDescriptors,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &TransformInfo,
+		},
+	};
+
+	vkUpdateDescriptorSets
+	(
+		rtg.device,
+		uint32_t(Writes.size()), Writes.data(), // descriptorWrites count, data
+		0, nullptr // descriptorCopies count, data
+	);
+
+	if (Growing)
+	{
+		std::cout << "Re-allocated per-frame buffers to " << NewBytes << " bytes." << std::endl;
+	}
+}
+
+void Tutorial::WriteObjectDescriptors(Workspace &workspace)
+{
+	// (the workspace's previous commands have finished, so its descriptors can be rewritten every frame)
+	VkDescriptorBufferInfo DrawsInfo
+	{
+		.buffer = workspace.FrameData.handle,
+		.offset = workspace.ObjectDrawsOffset,
+		.range = ObjectDraws.size() * sizeof(CullPipeline::Draw),
+	};
+	VkDescriptorBufferInfo VisibleInfo
+	{
+		.buffer = workspace.FrameData.handle,
+		.offset = workspace.ObjectVisibleOffset,
+		.range = ObjectInstances.size() * sizeof(uint32_t),
+	};
+
+	std::array< VkWriteDescriptorSet, 3 > Writes
+	{
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.TransformDescriptors,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &VisibleInfo,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.CullDescriptors,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &DrawsInfo,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = workspace.CullDescriptors,
+			.dstBinding = 2,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &VisibleInfo,
+		},
+	};
+
+	vkUpdateDescriptorSets
+	(
+		rtg.device,
+		uint32_t(Writes.size()), Writes.data(), // descriptorWrites count, data
+		0, nullptr // descriptorCopies count, data
+	);
+}
+
+void *Tutorial::UploadArenaAlloc(Workspace &workspace, VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize *Offset)
+{
+	Helpers::AllocatedBuffer &Arena = (workspace.DirectUpload ? workspace.FrameData : workspace.UploadArena);
+
+	VkDeviceSize Begin = AlignUp(workspace.UploadArenaUsed, Alignment);
+	if (Begin + Size > Arena.size)
+	{
+		throw std::runtime_error("Per-frame upload arena overflow (should have been reserved at the start of render).");
+	}
+	workspace.UploadArenaUsed = Begin + Size;
+
+	*Offset = Begin;
+	return reinterpret_cast< char * >(Arena.allocation.data()) + Begin;
 }
 
 void Tutorial::RenderLinesPipeline(Workspace &workspace)
 {
+	WriteTimestamp(workspace, LinesPass, false);
+
 	// Draw with the lines pipeline:
 		{
 			
 			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
 							LinesPipeline.Handle);
 			{
-				// Use LinesVertices (offset 0) as vertex buffer binding 0:
-				std::array< VkBuffer, 1 > VertexBuffers{ workspace.LinesVertices.handle };
-				std::array< VkDeviceSize, 1 > Offsets{ 0 };
+				// Use LinesVertices (in FrameData) as vertex buffer binding 0:
+				std::array< VkBuffer, 1 > VertexBuffers{ workspace.FrameData.handle };
+				std::array< VkDeviceSize, 1 > Offsets{ workspace.LinesVerticesOffset };
 				vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(VertexBuffers.size()),
 										VertexBuffers.data(), Offsets.data());
 			}
@@ -1114,29 +1704,39 @@ void Tutorial::RenderLinesPipeline(Workspace &workspace)
 			// Draw Lines vertices
 			 vkCmdDraw(workspace.command_buffer, uint32_t(LinesVertices.size()), 1, 0, 0);
 		}
+
+	WriteTimestamp(workspace, LinesPass, true);
 }
 
 void Tutorial::RenderObjectsPipeline(Workspace &workspace)
 {
-	// Draw with the objects pipeline:
-	if (!ObjectInstances.empty()) 
-	{ 
-		vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ObjectsPipeline.Handle);
+	WriteTimestamp(workspace, ObjectsPass, false);
+
+	// Draw with the objects pipeline: (unless there is nothing to draw -- then this frame's visible-instance descriptor wasn't written, either)
+	if (ObjectDraws.empty())
+	{
+		WriteTimestamp(workspace, ObjectsPass, true);
+		return;
 	}
+	vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ObjectsPipeline.Handle);
 
 	{
 		// use object_vertices (offset 0) as vertex buffer binding 0:
 		std::array< VkBuffer, 1 > VertexBuffers{ ObjectVertices.handle };
 		std::array< VkDeviceSize, 1 > Offsets{ 0 };
 		vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(VertexBuffers.size()), VertexBuffers.data(), Offsets.data());
+
+		// and each mesh's triangles as (absolute) indices into it:
+		vkCmdBindIndexBuffer(workspace.command_buffer, ObjectIndices.handle, 0, VK_INDEX_TYPE_UINT32);
 	}
 
-	// Bind World and Transforms descriptor sets:
+	// Bind World, Transforms, and (if Bindless) the texture array descriptor sets (once for all instances):
 	{
-		std::array< VkDescriptorSet, 2 > DescriptorSets
+		std::array< VkDescriptorSet, 3 > DescriptorSets
 		{
 			workspace.WorldDescriptors, 	// 0: World
 			workspace.TransformDescriptors, // 1: Transforms
+			ObjectsPipeline.Bindless ? TextureDescriptors[0] : VK_NULL_HANDLE, // 2: TEXTURES (otherwise bound per draw, below)
 		};
 		vkCmdBindDescriptorSets
 		(
@@ -1144,7 +1744,7 @@ void Tutorial::RenderObjectsPipeline(Workspace &workspace)
 			VK_PIPELINE_BIND_POINT_GRAPHICS, 	// Pipeline bind point
 			ObjectsPipeline.Layout, 			// Pipeline Layout
 			0, 									// First Set
-			uint32_t(DescriptorSets.size()), DescriptorSets.data(), // descriptor sets count, ptr
+			ObjectsPipeline.Bindless ? 3 : 2, DescriptorSets.data(), // descriptor sets count, ptr
 			0, nullptr // DynamicOffsets Count, ptr
 		);
 	}
@@ -1161,30 +1761,243 @@ void Tutorial::RenderObjectsPipeline(Workspace &workspace)
 
 	// Camera descriptor set is still bound, but unused(!)
 
-	// Draw all Instances:
-	for (ObjectInstance const &Inst : ObjectInstances)
+	// Draw all Instances: (one draw per mesh -- and per texture, without Bindless -- built in render() and culled by RenderCullPipeline)
+	if (ObjectsPipeline.Bindless && rtg.enabled_features.multiDrawIndirect && rtg.enabled_features.drawIndirectFirstInstance)
 	{
-		uint32_t Index = uint32_t(&Inst - &ObjectInstances[0]);
-		
-		vkCmdBindDescriptorSets
+		// (textures come from the instances' transforms)
+		vkCmdDrawIndexedIndirect(workspace.command_buffer, workspace.FrameData.handle, workspace.ObjectDrawsOffset, uint32_t(ObjectDraws.size()), sizeof(CullPipeline::Draw));
+	}
+	else
+	{
+		uint32_t BoundTexture = ~0u;
+		for (size_t Draw = 0; Draw < ObjectDraws.size(); ++Draw)
+		{
+			if (!ObjectsPipeline.Bindless && ObjectDrawTextures[Draw] != BoundTexture)
+			{
+				BoundTexture = ObjectDrawTextures[Draw];
+				vkCmdBindDescriptorSets
+				(
+					workspace.command_buffer, 			// Command Buffer
+					VK_PIPELINE_BIND_POINT_GRAPHICS, 	// Pipeline bind point
+					ObjectsPipeline.Layout, 			// Pipeline Layout
+					2, 									// First Set
+					1, &TextureDescriptors[BoundTexture], // descriptor sets count, ptr
+					0, nullptr // DynamicOffsets Count, ptr
+				);
+			}
+
+			if (rtg.enabled_features.drawIndirectFirstInstance)
+			{
+				// (without multiDrawIndirect, drawCount must be at most 1)
+				vkCmdDrawIndexedIndirect(workspace.command_buffer, workspace.FrameData.handle, workspace.ObjectDrawsOffset + Draw * sizeof(CullPipeline::Draw), 1, sizeof(CullPipeline::Draw));
+			}
+			else
+			{
+				// (indirect firstInstance must be zero without drawIndirectFirstInstance, so issue the same -- unculled -- draw directly)
+				VkDrawIndexedIndirectCommand const &Command = ObjectDraws[Draw].Command;
+				vkCmdDrawIndexed(workspace.command_buffer, Command.indexCount, Command.instanceCount, Command.firstIndex, Command.vertexOffset, Command.firstInstance);
+			}
+		}
+	}
+
+	WriteTimestamp(workspace, ObjectsPass, true);
+}
+//ENG~ Custom Render Function
+
+//BEGIN~ GPU Timing
+void Tutorial::WriteTimestamp(Workspace &workspace, GPUPass Pass, bool End)
+{
+	if (workspace.TimestampQueries == VK_NULL_HANDLE) return;
+
+	// bottom-of-pipe, so each timestamp marks when all previously-recorded work has finished:
+	vkCmdWriteTimestamp(workspace.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, workspace.TimestampQueries, 2 * Pass + (End ? 1 : 0));
+
+	if (End)
+	{
+		workspace.TimestampPassesWritten |= (1u << Pass);
+	}
+}
+
+void Tutorial::ReadTimestamps(Workspace &workspace)
+{
+	if (workspace.TimestampQueries == VK_NULL_HANDLE || workspace.TimestampPassesWritten == 0) return;
+
+	for (uint32_t Pass = 0; Pass < GPUPassCount; ++Pass)
+	{
+		if (!(workspace.TimestampPassesWritten & (1u << Pass))) continue;
+
+		// no WAIT bit: if the results somehow aren't ready, skip this frame rather than stalling
+		std::array< uint64_t, 2 > Ticks;
+		VkResult Result = vkGetQueryPoolResults
 		(
-			workspace.command_buffer,			// Command buffer
-			VK_PIPELINE_BIND_POINT_GRAPHICS,	// Pipeline bind point
-			ObjectsPipeline.Layout,				// Pipeline Layout
-			2, 	// Second Sets
-			1, &TextureDescriptors[Inst.Texture],	// descriptor sets count, ptr
-			0, nullptr	// Dynamic offsets count, ptr
+			rtg.device,
+			workspace.TimestampQueries,
+			2 * Pass, 2, 							// first query, query count
+			sizeof(Ticks), Ticks.data(), sizeof(Ticks[0]), 	// data size, data, stride
+			VK_QUERY_RESULT_64_BIT
 		);
-		
-		vkCmdDraw(workspace.command_buffer, Inst.Vertices.count, 1, Inst.Vertices.first, Index);
+		if (Result == VK_NOT_READY) continue;
+		VK( Result );
+
+		float Milliseconds = float(((Ticks[1] - Ticks[0]) & TimestampMask) * double(TimestampPeriod) * 1e-6);
+
+		std::array< float, GPUTimingWindow > &History = GPUPassHistory[Pass];
+		History[GPUPassHistoryCount[Pass] % GPUTimingWindow] = Milliseconds;
+		GPUPassHistoryCount[Pass] += 1;
+
+		uint32_t Samples = std::min(GPUPassHistoryCount[Pass], GPUTimingWindow);
+		float Total = 0.0f;
+		for (uint32_t i = 0; i < Samples; ++i)
+		{
+			Total += History[i];
+		}
+		GPUPassMilliseconds[Pass] = Total / Samples;
+
+		if (!configuration.CSV.empty() && workspace.TimestampFrame < TimingsPerFrame.size())
+		{
+			FrameTimings &Timings = TimingsPerFrame[workspace.TimestampFrame];
+			Timings.GPU[Pass] = Milliseconds;
+			Timings.GPUPasses |= (1u << Pass);
+		}
 	}
+
+	workspace.TimestampPassesWritten = 0;
+}
+
+void Tutorial::CollectCPUTimings()
+{
+	uint64_t Recorded = rtg.timing.recorded();
+	if (Recorded <= CPUTimingsCollected) return;
+
+	std::vector< FrameTiming::Sample > Samples;
+	rtg.timing.recent(uint32_t(std::min< uint64_t >(Recorded - CPUTimingsCollected, FrameTiming::Capacity)), &Samples);
+	for (FrameTiming::Sample const &Sample : Samples)
+	{
+		if (Sample.frame >= TimingsPerFrame.size()) continue;
+		TimingsPerFrame[Sample.frame].CPU = Sample;
+		TimingsPerFrame[Sample.frame].HasCPU = true;
+	}
+	CPUTimingsCollected = Recorded;
+}
+
+void Tutorial::WriteTimingsCSV()
+{
+	std::ofstream Out(configuration.CSV, std::ios::binary);
+	if (!Out)
+	{
+		std::cerr << "Failed to open '" << configuration.CSV << "' to write timings." << std::endl;
+		return;
+	}
+
+	// header; times are in milliseconds, and empty cells mean "not measured":
+	Out << "frame";
+	for (const char *Name : FrameTiming::StageNames)
+	{
+		Out << ",cpu_" << Name;
+	}
+	Out << ",cpu_frame";
+	for (const char *Name : GPUPassNames)
+	{
+		Out << ",gpu_" << Name;
+	}
+	Out << '\n';
+
+	for (FrameTimings const &Timings : TimingsPerFrame)
+	{
+		Out << (&Timings - &TimingsPerFrame[0]);
+		for (uint32_t Stage = 0; Stage < FrameTiming::StageCount; ++Stage)
+		{
+			Out << ',';
+			if (Timings.HasCPU) Out << Timings.CPU.ms[Stage];
+		}
+		Out << ',';
+		if (Timings.HasCPU) Out << Timings.CPU.frame_ms;
+		for (uint32_t Pass = 0; Pass < GPUPassCount; ++Pass)
+		{
+			Out << ',';
+			if (Timings.GPUPasses & (1u << Pass)) Out << Timings.GPU[Pass];
+		}
+		Out << '\n';
+	}
+
+	std::cout << "Wrote timings for " << TimingsPerFrame.size() << " frames to '" << configuration.CSV << "'." << std::endl;
+}
+//END~ GPU Timing
+
+void Tutorial::SaveScreenshot(bool Wait)
+{
+	std::vector< uint8_t > Pixels;
+	if (!rtg.helpers.take_readback(ScreenshotTicket, &Pixels, Wait)) return;
+	ScreenshotTicket = 0;
+
+	// PPM wants RGB; swapchain formats are (almost always) 8-bit BGRA or RGBA:
+	bool BGRA = (ScreenshotFormat == VK_FORMAT_B8G8R8A8_SRGB || ScreenshotFormat == VK_FORMAT_B8G8R8A8_UNORM);
+	bool RGBA = (ScreenshotFormat == VK_FORMAT_R8G8B8A8_SRGB || ScreenshotFormat == VK_FORMAT_R8G8B8A8_UNORM);
+	if (!BGRA && !RGBA)
+	{
+		std::cerr << "Can't save a screenshot of a " << string_VkFormat(ScreenshotFormat) << " image." << std::endl;
+		return;
+	}
+
+	size_t TexelCount = size_t(ScreenshotExtent.width) * ScreenshotExtent.height;
+	assert(Pixels.size() == TexelCount * 4);
+	std::vector< uint8_t > RGB(TexelCount * 3);
+	for (size_t i = 0; i < TexelCount; ++i)
+	{
+		RGB[3 * i + 0] = Pixels[4 * i + (BGRA ? 2 : 0)];
+		RGB[3 * i + 1] = Pixels[4 * i + 1];
+		RGB[3 * i + 2] = Pixels[4 * i + (BGRA ? 0 : 2)];
+	}
+
+	std::ofstream File(configuration.ScreenshotFile, std::ios::binary);
+	File << "P6\n" << ScreenshotExtent.width << " " << ScreenshotExtent.height << "\n255\n";
+	File.write(reinterpret_cast< char const * >(RGB.data()), std::streamsize(RGB.size()));
+	if (!File)
+	{
+		std::cerr << "Failed to write screenshot to '" << configuration.ScreenshotFile << "'." << std::endl;
+		return;
+	}
+	std::cout << "Saved frame " << *configuration.ScreenshotFrame << " to '" << configuration.ScreenshotFile << "'." << std::endl;
 }
-//ENG~ Custom Render Function
 
 void Tutorial::update(float dt)
 {
+	// in benchmark mode, every run renders exactly the same sequence of frames:
+	if (configuration.Benchmark)
+	{
+		dt = configuration.FixedDt;
+	}
+
+	// events recorded before this frame's update are delivered now, just as they were live:
+	if (Replay && !Replay->finished())
+	{
+		Replay->play(FrameCount, [this](InputEvent const &evt) { HandleInput(evt); });
+		if (Replay->finished())
+		{
+			std::cout << "Replay of '" << Replay->path << "' finished after frame " << FrameCount << "." << std::endl;
+		}
+	}
+
+	FrameCount += 1;
+
+	if (ScreenshotTicket != 0)
+	{
+		SaveScreenshot(false);
+	}
+
+	if (!configuration.CSV.empty())
+	{
+		TimingsPerFrame.resize(FrameCount);
+		CollectCPUTimings();
+	}
+
 	time = std::fmod(time + dt, 60.0f);
 
+	if (configuration.Benchmark && !Replay)
+	{
+		UpdateBenchmarkCamera();
+	}
+
 	// camera orbiting the origin:
 	if(CurrentCameraMode == CameraMode::Scene)
 	{
@@ -1308,12 +2121,79 @@ void Tutorial::update(float dt)
 				}
 			});
 		}
+
+		if (CullOnCPU())
+		{
+			CullObjectInstances();
+		}
 	}
 	
 }
 
+void Tutorial::CullObjectInstances()
+{
+	// world-space bounding spheres, gathered into SoA form for the (SSE) test:
+	CullSpheres.clear();
+	for (ObjectInstance const &Inst : ObjectInstances)
+	{
+		Mat4 const &M = Inst.Transform.WORLD_FROM_LOCAL;
+		auto const &Bounds = Inst.Vertices.Bounds;
+		Vec4 Center = M * Vec4{ Bounds.x, Bounds.y, Bounds.z, 1.0f };
+
+		// (scaled by the largest axis scale, so it still contains the mesh under non-uniform scale)
+		float Scale2 = std::max({
+			M[0] * M[0] + M[1] * M[1] + M[2] * M[2],
+			M[4] * M[4] + M[5] * M[5] + M[6] * M[6],
+			M[8] * M[8] + M[9] * M[9] + M[10] * M[10],
+		});
+		CullSpheres.push_back(Center[0], Center[1], Center[2], Bounds.r * std::sqrt(Scale2));
+	}
+
+	CullVisible.clear();
+	cull_spheres(Frustum::from_clip(CLIP_FROM_WORLD), CullSpheres, &CullVisible);
+
+	// keep only the visible instances, in order: (CullVisible is increasing, so each move is from the same or a later index)
+	for (size_t i = 0; i < CullVisible.size(); ++i)
+	{
+		if (CullVisible[i] != i)
+		{
+			ObjectInstances[i] = ObjectInstances[CullVisible[i]];
+		}
+	}
+	ObjectInstances.resize(CullVisible.size());
+}
+
+void Tutorial::UpdateBenchmarkCamera()
+{
+	// slow orbit around the scene with a gentle bob, computed from the frame number alone:
+	float T = float(double(FrameCount - 1) * configuration.FixedDt);
+
+	CurrentCameraMode = CameraMode::Free;
+	FreeCamera.TargetX = 0.0f;
+	FreeCamera.TargetY = 0.0f;
+	FreeCamera.TargetZ = 0.0f;
+	FreeCamera.Azimuth = std::fmod(0.5f * T, 2.0f * float(M_PI));
+	FreeCamera.Elevation = 0.25f * float(M_PI) + 0.15f * std::sin(0.4f * T);
+	FreeCamera.Radius = 3.0f + std::sin(0.25f * T);
+}
+
 void Tutorial::on_input(InputEvent const &evt) 
 {
+	// benchmark runs don't respond to the user, and neither do replays (until they run out of events):
+	if (configuration.Benchmark) return;
+	if (Replay && !Replay->finished()) return;
+
+	HandleInput(evt);
+}
+
+void Tutorial::HandleInput(InputEvent const &evt)
+{
+	// events from a replay are recorded as well, so a recording can be extended by replaying it with --record:
+	if (Recorder)
+	{
+		Recorder->record(FrameCount, evt);
+	}
+
 	// If there is a current action, it gets input priority:
 	if(Action)
 	{
@@ -1670,4 +2550,32 @@ void Tutorial::InstantializeTorus(std::vector< PosNorTexVertex > &Vertices)
 
 	TorusVertices.count = uint32_t(Vertices.size()) - TorusVertices.first;
 }
+
+void Tutorial::ComputeBounds(std::vector< PosNorTexVertex > const &Vertices, ObjectVerticesInfo &Mesh)
+{
+	if (Mesh.count == 0) return;
+
+	// center of the bounding box, and the farthest vertex from it (not the smallest sphere, but close for these meshes):
+	float Min[3]{ INFINITY, INFINITY, INFINITY };
+	float Max[3]{ -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t i = Mesh.first; i < Mesh.first + Mesh.count; ++i)
+	{
+		auto const &P = Vertices[i].Position;
+		Min[0] = std::min(Min[0], P.x); Max[0] = std::max(Max[0], P.x);
+		Min[1] = std::min(Min[1], P.y); Max[1] = std::max(Max[1], P.y);
+		Min[2] = std::min(Min[2], P.z); Max[2] = std::max(Max[2], P.z);
+	}
+
+	Mesh.Bounds.x = 0.5f * (Min[0] + Max[0]);
+	Mesh.Bounds.y = 0.5f * (Min[1] + Max[1]);
+	Mesh.Bounds.z = 0.5f * (Min[2] + Max[2]);
+	float Radius2 = 0.0f;
+	for (uint32_t i = Mesh.first; i < Mesh.first + Mesh.count; ++i)
+	{
+		auto const &P = Vertices[i].Position;
+		float DX = P.x - Mesh.Bounds.x, DY = P.y - Mesh.Bounds.y, DZ = P.z - Mesh.Bounds.z;
+		Radius2 = std::max(Radius2, DX * DX + DY * DY + DZ * DZ);
+	}
+	Mesh.Bounds.r = std::sqrt(Radius2);
+}
 //END~ Instantialize Mesh's Vertices
\ No newline at end of file
@@ -3,12 +3,16 @@
 #include "PosColVertex.hpp"
 #include "PosNorTexVertex.hpp"
 #include "mat4.hpp"
+#include "InputRecording.hpp"
+#include "FrustumCull.hpp"
 
 #include "RTG.hpp"
 
 struct Tutorial : RTG::Application {
 
-	Tutorial(RTG &);
+	struct Configuration;
+
+	Tutorial(RTG &, Configuration const &);
 	Tutorial(Tutorial const &) = delete; //you shouldn't be copying this object
 	~Tutorial();
 
@@ -74,8 +78,10 @@ struct Tutorial : RTG::Application {
 	{
 		// Descriptor set Layouts:
 		VkDescriptorSetLayout Set0_World = VK_NULL_HANDLE;
-		VkDescriptorSetLayout Set1_Transforms = VK_NULL_HANDLE;
-		VkDescriptorSetLayout Set2_TEXTURE = VK_NULL_HANDLE;
+		VkDescriptorSetLayout Set1_Transforms = VK_NULL_HANDLE; // TRANSFORMS, and VISIBLE (the transform index of each drawn instance)
+		VkDescriptorSetLayout Set2_TEXTURE = VK_NULL_HANDLE; // every texture, as an array (if Bindless); otherwise a single texture, bound per draw
+		uint32_t MaxTextures = 4096; // size limit of Set2_TEXTURE's array (lowered to fit device limits by Create)
+		bool Bindless = true; // set by Create: whether the device's descriptor indexing features allow the texture array
 		
 		struct Push
 		{
@@ -113,8 +119,11 @@ struct Tutorial : RTG::Application {
 			Mat4 CLIP_FROM_LOCAL;
 			Mat4 WORLD_FROM_LOCAL;
 			Mat4 WORLD_FROM_LOCAL_NORMAL;
+			uint32_t TEXTURE = 0; // index into Set2_TEXTURE's array (unused without Bindless)
+			uint32_t DRAW = 0; // index of the instance's mesh in ObjectDraws (used by CullPipeline)
+			uint32_t padding_[2] = {};
 		};
-		static_assert(sizeof(Transform) == 16*4 + 16*4 + 16*4, "Transform is the expected size.");
+		static_assert(sizeof(Transform) == 16*4 + 16*4 + 16*4 + 4*4, "Transform is the expected size.");
 
 		using Vertex = PosNorTexVertex;
 
@@ -128,6 +137,37 @@ struct Tutorial : RTG::Application {
 		void Destroy(RTG &);
 	} ObjectsPipeline;
 
+	// Cull Pipeline (compute): tests each instance's bounding sphere against the view frustum and appends the visible ones to their draw
+	struct CullPipeline
+	{
+		// TRANSFORMS (read), DRAWS (instanceCount incremented), and VISIBLE (written):
+		VkDescriptorSetLayout Set0_Instances = VK_NULL_HANDLE;
+
+		struct Push
+		{
+			float PLANES[6][4];	// frustum planes (xyz normal pointing inward, w offset) in world space
+			uint32_t INSTANCES;	// number of transforms to test
+		};
+
+		// one indexed indirect draw per mesh, followed by the mesh's bounding sphere (drawn with a stride of sizeof(Draw)):
+		struct Draw
+		{
+			VkDrawIndexedIndirectCommand Command;
+			uint32_t padding_[3] = {};				// (std430 aligns BOUNDS to 16 bytes)
+			struct { float x, y, z, r; } BOUNDS;	// local space
+		};
+		static_assert(sizeof(Draw) == 5*4 + 3*4 + 4*4, "Draw is the expected size.");
+
+		static constexpr uint32_t WorkgroupSize = 64; // must match local_size_x in cull.comp
+
+		VkPipelineLayout Layout = VK_NULL_HANDLE;
+
+		VkPipeline Handle = VK_NULL_HANDLE;
+
+		void Create(RTG &);
+		void Destroy(RTG &);
+	} CullPipeline;
+
 	enum PatternType
 	{	
 		None,
@@ -135,6 +175,75 @@ struct Tutorial : RTG::Application {
 		Grid,
 		BlackHole,
 	} PatternType = Grid;
+
+	// Application options, parsed alongside RTG::Configuration:
+	struct Configuration
+	{
+		// deterministic benchmark: update() uses FixedDt instead of wall-clock time and the camera follows a scripted orbit (unless replaying input)
+		// `--benchmark` command-line flag
+		bool Benchmark = false;
+
+		// timestep used in benchmark mode (seconds):
+		// `--fixed-dt <seconds>` command-line flag
+		float FixedDt = 1.0f / 60.0f;
+
+		// if set, overrides the default pattern:
+		// `--pattern <none|x|grid|blackhole>` command-line flag
+		std::optional< enum PatternType > Pattern;
+
+		// if non-empty, per-frame CPU and GPU timings are written to this file at exit:
+		// `--csv <file>` command-line flag
+		std::string CSV;
+
+		// if non-empty, every input event handled is recorded (with its frame number) to this file:
+		// `--record <file>` command-line flag
+		std::string Record;
+
+		// if non-empty, input events are replayed from this file at their recorded frames (live input is ignored until it ends):
+		// `--replay <file>` command-line flag
+		std::string Replay;
+
+		// if true, always stage per-frame data through a host buffer, even when the device has host-visible device-local memory:
+		// `--staged-uploads` command-line flag
+		bool StagedUploads = false;
+
+		// if true, textures get full mip chains (generated on the GPU) and are sampled trilinearly; otherwise, one level sampled with nearest filtering:
+		// `--no-mipmaps` command-line flag
+		bool Mipmaps = true;
+
+		// if true, textures are loaded from their block-compressed .ktx2 versions (made by bin/texture-compressor) when those exist and the device supports BC formats:
+		// `--no-compressed-textures` command-line flag
+		bool CompressedTextures = true;
+
+		// if true, decoded textures are saved to (and on later runs mapped from) TextureCacheDirectory, keyed by a hash of the source file:
+		// `--no-texture-cache` command-line flag
+		bool TextureCache = true;
+		static constexpr char const *TextureCacheDirectory = "../texture-cache";
+
+		// where object instances are frustum culled: in a compute pass before drawing (on the CPU instead if the device can't draw indirectly with a firstInstance),
+		// on the CPU in update() before their transforms are uploaded, or not at all:
+		// `--culling <gpu|cpu|none>` command-line flag
+		enum CullingMode
+		{
+			NoCulling,
+			CPUCulling,
+			GPUCulling,
+		} Culling = GPUCulling;
+
+		// maximum anisotropy for texture sampling (clamped to what the device supports; 1 turns anisotropic filtering off):
+		// `--anisotropy <N>` command-line flag
+		float Anisotropy = 16.0f;
+
+		// if set, the swapchain image rendered in this frame (counting from 1) is read back and saved to ScreenshotFile (as a binary PPM):
+		// `--screenshot <frame> <file.ppm>` command-line flag
+		std::optional< uint64_t > ScreenshotFrame;
+		std::string ScreenshotFile;
+
+		// try to parse argv[argi] (and any parameters); returns false if it isn't a Tutorial option. Throws on error.
+		bool ParseArg(int argc, char **argv, int &argi);
+		static void Usage(std::function< void(const char *, const char *) > const &callback);
+	};
+	Configuration configuration;
 	
 
 	// Pools from which per-workspace things are allocated:
@@ -146,34 +255,93 @@ struct Tutorial : RTG::Application {
 	{
 		VkCommandBuffer command_buffer = VK_NULL_HANDLE; //from the command pool above; reset at the start of every render.
 
-		//location for ObjectsPipeline::World data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer WorldSrc; 	// host coherent; mapped
-		Helpers::AllocatedBuffer World; 	// device-local
-		VkDescriptorSet WorldDescriptors; 	// references World
+		// Per-frame data (Camera, World, Transforms, LinesVertices, object draws, then visible instances) is bump-allocated from UploadArena in render()
+		// -- which is reset every frame, since the workspace fence has signaled by then -- and copied to FrameData with one command.
+		// When the device has host-visible device-local memory, FrameData is written directly instead (and UploadArena is unused):
+		Helpers::AllocatedBuffer UploadArena;	// host coherent; mapped
+		Helpers::AllocatedBuffer FrameData;		// device-local; same layout as UploadArena (mapped if DirectUpload)
+		bool DirectUpload = false;				// FrameData is host-writable, so no copy is needed
+		VkDeviceSize UploadArenaUsed = 0;		// bytes bump-allocated from UploadArena so far this frame
+		VkDeviceSize LinesVerticesOffset = 0;	// where this frame's lines vertices are in FrameData
+		VkDeviceSize ObjectDrawsOffset = 0;		// where this frame's object draws (CullPipeline::Draw) are in FrameData
+		VkDeviceSize ObjectVisibleOffset = 0;	// where this frame's visible instances (transform indices) are in FrameData
+
+		VkDescriptorSet WorldDescriptors; 		// references ObjectsPipeline::World in FrameData
+		VkDescriptorSet CameraDescriptors;		// references LinesPipeline::Camera in FrameData
+		VkDescriptorSet TransformDescriptors;	// references ObjectsPipeline::Transforms (to the end of) FrameData, and this frame's visible instances
+		VkDescriptorSet CullDescriptors;		// references Transforms, and this frame's object draws and visible instances
+
+		// GPU timestamps before/after each pass; read back the next time this workspace is rendered:
+		VkQueryPool TimestampQueries = VK_NULL_HANDLE;
+		uint32_t TimestampPassesWritten = 0;	// bitmask of (1 << GPUPass) with timestamps pending in TimestampQueries
+		uint64_t TimestampFrame = 0;			// frame the pending timestamps belong to
+	};
+	std::vector< Workspace > workspaces;
 
-		// Location for lines data:( streamed to GPU per-frame)
-		Helpers::AllocatedBuffer LinesVerticesSrc;	// host coherent; mapped
-		Helpers::AllocatedBuffer LinesVertices;		// device-local
+	// fixed offsets of the descriptor-referenced parts of Workspace::FrameData (set in the constructor from device limits):
+	VkDeviceSize UniformAlignment = 1;
+	VkDeviceSize StorageAlignment = 1;
+	VkDeviceSize MaxStorageRange = 0;
+	VkDeviceSize CameraOffset = 0;
+	VkDeviceSize WorldOffset = 0;
+	VkDeviceSize TransformsOffset = 0;
+
+	// [re]create a workspace's UploadArena and FrameData if they are smaller than Bytes (and point its descriptors at the new FrameData):
+	void ReserveFrameData(Workspace &workspace, VkDeviceSize Bytes);
+	// point the descriptors of this frame's object draws and visible instances at their place in FrameData:
+	void WriteObjectDescriptors(Workspace &workspace);
+	// bump-allocate from a workspace's UploadArena (or FrameData, if DirectUpload); returns a pointer to the mapped memory and the offset in *Offset:
+	void *UploadArenaAlloc(Workspace &workspace, VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize *Offset);
 
-		// location for LinesPipeline::Camera data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer CameraSrc;	// host coherent; mapped
-		Helpers::AllocatedBuffer Camera;		// device-local
-		VkDescriptorSet CameraDescriptors;		// references Camera
+	//--------------------------------------------------------------------
+	// GPU timing:
 
-		// location for ObjectsPipeline::Transforms data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer TransformsSrc;	// host coherent; mapped
-		Helpers::AllocatedBuffer Transforms;	// device-local
-		VkDescriptorSet TransformDescriptors;	// references Transforms
+	enum GPUPass : uint32_t
+	{
+		UploadPass,
+		CullPass,
+		BackgroundPass,
+		LinesPass,
+		ObjectsPass,
+		GPUPassCount
 	};
-	std::vector< Workspace > workspaces;
+	static constexpr std::array< const char *, GPUPassCount > GPUPassNames{ "upload", "cull", "background", "lines", "objects" };
+
+	float TimestampPeriod = 0.0f;	// nanoseconds per timestamp tick; 0 if the graphics queue can't write timestamps
+	uint64_t TimestampMask = 0;		// valid bits of a timestamp
+
+	// rolling average of GPU milliseconds per pass over the last GPUTimingWindow frames that ran the pass:
+	std::array< float, GPUPassCount > GPUPassMilliseconds{};
+
+	static constexpr uint32_t GPUTimingWindow = 64;
+	std::array< std::array< float, GPUTimingWindow >, GPUPassCount > GPUPassHistory{};
+	std::array< uint32_t, GPUPassCount > GPUPassHistoryCount{};
+
+	void WriteTimestamp(Workspace &workspace, GPUPass Pass, bool End);
+	void ReadTimestamps(Workspace &workspace);
+
+	// per-frame timings kept for configuration.CSV:
+	struct FrameTimings
+	{
+		bool HasCPU = false;
+		FrameTiming::Sample CPU;
+		uint32_t GPUPasses = 0;		// bitmask of (1 << GPUPass) with valid GPU times
+		std::array< float, GPUPassCount > GPU{};
+	};
+	std::vector< FrameTimings > TimingsPerFrame;
+	uint64_t CPUTimingsCollected = 0;	// frames of rtg.timing already copied into TimingsPerFrame
+	void CollectCPUTimings();
+	void WriteTimingsCSV();
 
 	//-------------------------------------------------------------------
 	//static scene resources:
-	Helpers::AllocatedBuffer ObjectVertices;
+	Helpers::AllocatedBuffer ObjectVertices;	// welded vertices of all meshes
+	Helpers::AllocatedBuffer ObjectIndices;		// uint32 triangle lists of all meshes, indexing ObjectVertices
 	struct ObjectVerticesInfo
 	{
-		uint32_t first = 0;
-		uint32_t count = 0;
+		uint32_t first = 0;	// first index in ObjectIndices (while a mesh is being built: first vertex of its unindexed triangles)
+		uint32_t count = 0;	// number of indices (while being built: number of vertices)
+		struct { float x, y, z, r; } Bounds{};	// bounding sphere (local space)
 	};
 	ObjectVerticesInfo PlaneVertices;
 	ObjectVerticesInfo TorusVertices;
@@ -184,7 +352,10 @@ struct Tutorial : RTG::Application {
 	std::vector< VkImageView > TextureViews;
 	VkSampler TextureSampler = VK_NULL_HANDLE;
 	VkDescriptorPool TextureDescriptorPool = VK_NULL_HANDLE;
-	std::vector< VkDescriptorSet > TextureDescriptors;
+	std::vector< VkDescriptorSet > TextureDescriptors; // ObjectsPipeline::Set2_TEXTURE: one set holding all of TextureViews, in order (if Bindless); otherwise one set per texture
+
+	// uploads of the resources above (the first frame can't render until the graphics queue has acquired them):
+	Helpers::UploadTicket SceneUploads = 0;
 
 	//--------------------------------------------------------------------
 	//Resources that change when the swapchain is resized:
@@ -208,6 +379,23 @@ struct Tutorial : RTG::Application {
 
 	float time = 0.0f;
 
+	// number of update() calls so far (so the frame being rendered is FrameCount - 1):
+	uint64_t FrameCount = 0;
+
+	// camera path used in benchmark mode (depends only on FrameCount):
+	void UpdateBenchmarkCamera();
+
+	// input session recording / playback (see InputRecording.hpp):
+	std::unique_ptr< InputRecorder > Recorder;
+	std::unique_ptr< InputReplay > Replay;
+	void HandleInput(InputEvent const &);
+
+	// screenshot readback (see Configuration::ScreenshotFrame), written out once it arrives:
+	Helpers::ReadbackTicket ScreenshotTicket = 0;
+	VkExtent2D ScreenshotExtent{};
+	VkFormat ScreenshotFormat = VK_FORMAT_UNDEFINED;
+	void SaveScreenshot(bool Wait);
+
 	enum class CameraMode
 	{
 		Scene = 0,
@@ -238,16 +426,32 @@ struct Tutorial : RTG::Application {
 	{
 		ObjectVerticesInfo Vertices;
 		ObjectsPipeline::Transform Transform;
-		uint32_t Texture = 0;
+		uint32_t Texture = 0; // (copied to Transform.TEXTURE on upload)
 	};
 
 	std::vector<ObjectInstance> ObjectInstances;
 
+	// ObjectInstances grouped by mesh, rebuilt each frame in render(): one indexed indirect draw per mesh, with that mesh's transforms at [firstInstance, firstInstance + instanceCount)
+	// (without ObjectsPipeline.Bindless, draws are per mesh and texture, since the texture is bound per draw)
+	// (when culling on the GPU, the uploaded instanceCounts start at zero and the visible instances are appended by CullPipeline)
+	std::vector< CullPipeline::Draw > ObjectDraws;
+	std::vector< uint32_t > ObjectDrawTextures;	// texture of each draw in ObjectDraws (only set without ObjectsPipeline.Bindless)
+	std::vector< uint32_t > ObjectDrawOf;	// index in ObjectDraws of each instance
+	std::vector< uint32_t > ObjectDrawNext;	// next free transform of each draw while writing
+
 	//--------------------------------------------------------------------
 	//Rendering function, uses all the resources above to queue work to draw a frame:
 
 	virtual void render(RTG &, RTG::RenderParams const &) override;
 	void RenderCustom(Workspace &workspace);
+	void RenderCullPipeline(Workspace &workspace);
+	bool CullOnGPU() const;
+	bool CullOnCPU() const;
+
+	// drop the ObjectInstances whose bounding spheres are outside the view frustum (called by update() when CullOnCPU()):
+	void CullObjectInstances();
+	SphereSoA CullSpheres;				// world-space bounding sphere of each instance
+	std::vector< uint32_t > CullVisible;	// indices of the instances that pass
 	void RenderBackgroundPipeline(Workspace &workspace);
 	void RenderLinesPipeline(Workspace &workspace);
 	void RenderObjectsPipeline(Workspace &workspace);
@@ -307,4 +511,6 @@ struct Tutorial : RTG::Application {
 // Different Mesh Vertices Instantialize
 	void InstantializePlane(std::vector< PosNorTexVertex > &Vertices);
 	void InstantializeTorus(std::vector< PosNorTexVertex > &Vertices);
+	// bounding sphere of Vertices[Mesh.first, Mesh.first + Mesh.count), into Mesh.Bounds:
+	static void ComputeBounds(std::vector< PosNorTexVertex > const &Vertices, ObjectVerticesInfo &Mesh);
 };
@@ -20,10 +20,14 @@ int main(int argc, char **argv) {
 			.apiVersion = VK_API_VERSION_1_3
 		};
 
+		Tutorial::Configuration tutorial_configuration;
+
 		bool print_usage = false;
 
 		try {
-			configuration.parse(argc, argv);
+			configuration.parse(argc, argv, [&](int argc, char **argv, int &argi) {
+				return tutorial_configuration.ParseArg(argc, argv, argi);
+			});
 		} catch (std::runtime_error &e) {
 			std::cerr << "Failed to parse arguments:\n" << e.what() << std::endl;
 			print_usage = true;
@@ -31,9 +35,11 @@ int main(int argc, char **argv) {
 
 		if (print_usage) {
 			std::cerr << "Usage:" << std::endl;
-			RTG::Configuration::usage( [](const char *arg, const char *desc){ 
+			auto print = [](const char *arg, const char *desc){ 
 				std::cerr << "    " << arg << "\n        " << desc << std::endl;
-			});
+			};
+			RTG::Configuration::usage(print);
+			Tutorial::Configuration::Usage(print);
 			return 1;
 		}
 
@@ -41,7 +47,7 @@ int main(int argc, char **argv) {
 		RTG rtg(configuration);
 
 		//initializes global (whole-life-of-application) resources:
-		Tutorial application(rtg);
+		Tutorial application(rtg, tutorial_configuration);
 
 		//main loop -- handles events, renders frames, etc:
 		rtg.run(application);
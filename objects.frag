@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(push_constant) uniform Push
 {
@@ -13,10 +14,12 @@ layout(set=0,binding=0,std140) uniform World
 	vec3 SUN_ENERGY; 	// energy supplied by sun to a surface patch with normal = SUN_DIRECTION
 };
 
-layout(set=2,binding=0) uniform sampler2D TEXTURE;
+// every texture (sized when the set is allocated); instances in one draw may use different ones, hence nonuniformEXT:
+layout(set=2,binding=0) uniform sampler2D TEXTURES[];
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 texcoord;
+layout(location=3) flat in uint textureIndex;
 
 layout(location=0) out vec4 outColor;
 
@@ -25,7 +28,7 @@ void main()
 {
 	vec3 n = normalize(normal);
 	vec2 NewUV = texcoord + vec2(0.1, 0.2) * time;
-	vec3 albedo = texture(TEXTURE, NewUV).rgb;
+	vec3 albedo = texture(TEXTURES[nonuniformEXT(textureIndex)], NewUV).rgb;
 
 	// hemisphere sky + directional sun:
 	vec3 e = SKY_ENERGY * (0.5 * dot(n, SKY_DIRECTION) + 0.5)
@@ -5,6 +5,8 @@ struct Transform
 	mat4 CLIP_FROM_LOCAL;
 	mat4 WORLD_FROM_LOCAL;
 	mat4 WORLD_FROM_LOCAL_NORMAL;
+	uint TEXTURE; // index into the TEXTURES array (set 2)
+	uint DRAW; // (used by cull.comp)
 };
 
 layout(set=1, binding=0, std140) readonly buffer Transforms
@@ -12,6 +14,12 @@ layout(set=1, binding=0, std140) readonly buffer Transforms
 	Transform TRANSFORMS[];
 };
 
+// transform index of each drawn instance (written by cull.comp, or in order when not culling):
+layout(set=1, binding=1, std430) readonly buffer Visible
+{
+	uint VISIBLE[];
+};
+
 layout(location=0) in vec3 Position;
 layout(location=1) in vec3 Normal;
 layout(location=2) in vec2 Texcoord;
@@ -19,11 +27,14 @@ layout(location=2) in vec2 Texcoord;
 layout(location=0) out vec3 position;
 layout(location=1) out vec3 normal;
 layout(location=2) out vec2 texcoord;
+layout(location=3) flat out uint textureIndex;
 
 void main() 
 {
-	gl_Position = TRANSFORMS[gl_InstanceIndex].CLIP_FROM_LOCAL * vec4(Position, 1.0);
-	position = mat4x3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL) * vec4(Position, 1.0);
-	normal = mat3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL_NORMAL) * Normal;
+	uint Instance = VISIBLE[gl_InstanceIndex];
+	gl_Position = TRANSFORMS[Instance].CLIP_FROM_LOCAL * vec4(Position, 1.0);
+	position = mat4x3(TRANSFORMS[Instance].WORLD_FROM_LOCAL) * vec4(Position, 1.0);
+	normal = mat3(TRANSFORMS[Instance].WORLD_FROM_LOCAL_NORMAL) * Normal;
 	texcoord = Texcoord;
+	textureIndex = TRANSFORMS[Instance].TEXTURE;
 }